@@ -0,0 +1,20 @@
+/*  avr/eeprom.h  host build stand-in, see avrsim.h
+    EEMEM data is gathered in its own section, which the simulator
+    copies into its EEPROM array at reset the way avrdude programs the
+    EEP file
+*/
+
+#ifndef AVRHOST_EEPROM_H
+#define AVRHOST_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM __attribute__((section("avrsim_eeprom"), used))
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+
+#endif
@@ -0,0 +1,19 @@
+/*  avr/interrupt.h  host build stand-in, see avrsim.h
+    the firmware's main() becomes firmware_main() so a host program can
+    run it under the simulator
+*/
+
+#ifndef AVRHOST_INTERRUPT_H
+#define AVRHOST_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define main firmware_main
+
+#define cli() avrsim_cli()
+#define sei() avrsim_sei()
+
+#define SIGNAL(vector) void vector(void)
+#define SIG_OVERFLOW1 avrsim_timer1_ovf
+
+#endif
@@ -0,0 +1,47 @@
+/*  avr/io.h  host build stand-in for the ATTiny2313 registers the VS4T1
+              firmware uses, see avrsim.h
+*/
+
+#ifndef AVRHOST_IO_H
+#define AVRHOST_IO_H
+
+#include <stdint.h>
+#include "../../avrsim.h"
+
+/* registers with side effects go through the simulator */
+#define UCSRA (*avrsim_ucsra())
+#define UDR (*avrsim_udr())
+#define PORTB (*avrsim_portb())
+#define TCNT1 (*avrsim_tcnt1())
+
+/* plain registers */
+#define UCSRB avrsim_regs.ucsrb
+#define UCSRC avrsim_regs.ucsrc
+#define UBRRH avrsim_regs.ubrrh
+#define UBRRL avrsim_regs.ubrrl
+#define DDRB avrsim_regs.ddrb
+#define DDRD avrsim_regs.ddrd
+#define TIMSK avrsim_regs.timsk
+#define TCCR1B avrsim_regs.tccr1b
+
+/* UCSRA */
+#define RXC 7
+#define TXC 6
+#define UDRE 5
+#define DOR 3
+#define U2X 1
+/* UCSRB */
+#define RXEN 4
+#define TXEN 3
+/* UCSRC */
+#define UCSZ0 1
+/* TCCR1B */
+#define CS10 0
+#define CS11 1
+#define CS12 2
+/* TIMSK */
+#define TOIE1 7
+
+#define _BV(bit) (1 << (bit))
+
+#endif
@@ -0,0 +1,11 @@
+/*  avr/pgmspace.h  host build stand-in, flash strings are plain strings */
+
+#ifndef AVRHOST_PGMSPACE_H
+#define AVRHOST_PGMSPACE_H
+
+typedef const char *PGM_P;
+
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const unsigned char *) (p))
+
+#endif
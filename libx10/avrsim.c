@@ -0,0 +1,296 @@
+/*  avrsim.c  simulated ATTiny2313 for the host build of the firmware
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+*/
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include "avrsim.h"
+
+#define EESIZE 128
+#define CLOCKMHZ 8
+#define NEVER UINT64_MAX
+
+enum { HOOK_OTHER, HOOK_UCSRA, HOOK_UCSRA_RXC };
+
+struct avrsim_registers avrsim_regs;
+
+/* EEMEM data, see avr/eeprom.h */
+extern const unsigned char __start_avrsim_eeprom[] __attribute__((weak));
+extern const unsigned char __stop_avrsim_eeprom[] __attribute__((weak));
+
+static struct {
+  const struct avrsim_io *io;
+  jmp_buf stop;
+  uint64_t now, end;
+  int ienable;		/* the I flag */
+  int intimer;		/* running the timer1 handler */
+  int lasthook;
+  int udrread;		/* next UDR access is a read */
+  int txpending;
+  uint64_t txstart, txdone;
+  uint64_t lastarrival;
+  unsigned char rxq[AVRSIM_RXFIFO];
+  int rxcount;
+  int tcntwritten;
+  uint64_t tcnttime, overflow;
+  unsigned char portb;
+  unsigned char eeprom[EESIZE];
+  struct avrsim_stats stats;
+} sim;
+
+static uint64_t bytetime(void)
+{
+  /* 10 bits at F_CPU / (16 * (UBRR + 1)), or 8 * with U2X */
+  uint64_t bit16 = 16 * ((avrsim_regs.ubrrh << 8 | avrsim_regs.ubrrl) + 1);
+
+  if (avrsim_regs.ucsra & (1 << U2X)) bit16 /= 2;
+  return 10 * bit16 / CLOCKMHZ;
+}
+
+/* microseconds per timer1 tick, 0 when stopped */
+static uint64_t ticktime(void)
+{
+  static const int prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  int p = prescale[avrsim_regs.tccr1b & 7];
+
+  return p < CLOCKMHZ ? (p > 0) : p / CLOCKMHZ;
+}
+
+static int timeron(void)
+{
+  return (avrsim_regs.timsk & (1 << TOIE1)) && ticktime() > 0;
+}
+
+/* moves bytes that are on the line by now into the receive FIFO */
+static void receive(void)
+{
+  uint64_t t;
+  unsigned char byte;
+
+  while (sim.io->rx(sim.io->ctx, &t, &byte) > 0) {
+    if (t < sim.lastarrival + bytetime()) t = sim.lastarrival + bytetime();
+    /* a byte is there once its stop bit is */
+    if (t + bytetime() > sim.now) break;
+    sim.io->rxtake(sim.io->ctx);
+    sim.lastarrival = t;
+    sim.stats.rxbytes++;
+    if (sim.rxcount < AVRSIM_RXFIFO) sim.rxq[sim.rxcount++] = byte;
+    else sim.stats.overruns++;
+  }
+}
+
+/* time the next received byte is complete, NEVER if none */
+static uint64_t nextarrival(void)
+{
+  uint64_t t;
+  unsigned char byte;
+
+  if (sim.io->rx(sim.io->ctx, &t, &byte) <= 0) return NEVER;
+  if (t < sim.lastarrival + bytetime()) t = sim.lastarrival + bytetime();
+  return t + bytetime();
+}
+
+/* catches up with what the firmware did since the last hook */
+static void sync(void)
+{
+  if (sim.txpending) {
+    sim.txpending = 0;
+    sim.stats.txbytes++;
+    if (sim.io->tx != NULL)
+      sim.io->tx(sim.io->ctx, sim.txstart, avrsim_regs.udr);
+  }
+
+  if (sim.tcntwritten) {
+    sim.tcntwritten = 0;
+    sim.overflow = sim.tcnttime + (65536 - avrsim_regs.tcnt1) * ticktime();
+  }
+
+  if (avrsim_regs.portb != sim.portb) {
+    sim.stats.portbchanges++;
+    if (sim.io->portb != NULL)
+      sim.io->portb(sim.io->ctx, sim.now, sim.portb, avrsim_regs.portb);
+    sim.portb = avrsim_regs.portb;
+  }
+
+  receive();
+
+  while (sim.ienable && timeron() && sim.now >= sim.overflow) {
+    /* the counter wraps unless the handler reloads it */
+    sim.overflow += 65536 * ticktime();
+    sim.stats.interrupts++;
+    sim.ienable = 0;
+    sim.lasthook = HOOK_OTHER;
+    sim.intimer = 1;
+    avrsim_timer1_ovf();
+    sync();
+    sim.intimer = 0;
+    sim.ienable = 1;
+  }
+}
+
+static void stop(void)
+{
+  sync();
+  longjmp(sim.stop, 1);
+}
+
+/* the main loop is idle, jump to whatever happens next */
+static void idle(void)
+{
+  uint64_t next = nextarrival();
+
+  if (next == NEVER && sim.end == 0) stop();
+  if (sim.ienable && timeron() && sim.overflow < next) next = sim.overflow;
+  if (sim.end != 0 && next > sim.end) {
+    next = sim.end;
+    if (sim.now >= sim.end) stop();
+  }
+  if (next > sim.now) {
+    if (sim.io->idle != NULL) sim.io->idle(sim.io->ctx, sim.now, next);
+    sim.now = next;
+  }
+  sync();
+}
+
+volatile uint8_t *avrsim_ucsra(void)
+{
+  sync();
+  /* waiting on UDRE, with or without received bytes, skips to when
+     the transmit buffer frees, and waiting on TXC to when it is sent */
+  if (sim.lasthook != HOOK_OTHER && sim.now + bytetime() < sim.txdone) {
+    sim.now = sim.txdone - bytetime();
+    sync();
+  } else if (sim.lasthook != HOOK_OTHER && sim.now < sim.txdone) {
+    sim.now = sim.txdone;
+    sync();
+  } else if (sim.rxcount == 0 && sim.lasthook == HOOK_UCSRA) idle();
+
+  /* the transmit buffer is free once the byte before is shifting */
+  avrsim_regs.ucsra &= (1 << U2X) | 1;
+  if (sim.rxcount > 0) avrsim_regs.ucsra |= 1 << RXC;
+  if (sim.now + bytetime() >= sim.txdone) avrsim_regs.ucsra |= 1 << UDRE;
+  if (sim.now >= sim.txdone) avrsim_regs.ucsra |= 1 << TXC;
+
+  sim.lasthook = sim.rxcount > 0 ? HOOK_UCSRA_RXC : HOOK_UCSRA;
+  return &avrsim_regs.ucsra;
+}
+
+volatile uint8_t *avrsim_udr(void)
+{
+  sync();
+  sim.lasthook = HOOK_OTHER;
+
+  if (sim.udrread) {
+    sim.udrread = 0;
+    if (sim.rxcount > 0) {
+      avrsim_regs.udr = sim.rxq[0];
+      memmove(sim.rxq, sim.rxq + 1, --sim.rxcount);
+    }
+    return &avrsim_regs.udr;
+  }
+
+  /* a write: TransmitByte's delay, which the firmware skips at the U2X
+     programming rate, then wait for the buffer */
+  if (!(avrsim_regs.ucsra & (1 << U2X))) sim.now += AVRSIM_TXLOOP;
+  if (sim.txdone > sim.now + bytetime()) sim.now = sim.txdone - bytetime();
+  sim.txstart = sim.now > sim.txdone ? sim.now : sim.txdone;
+  sim.txdone = sim.txstart + bytetime();
+  sim.txpending = 1;
+  return &avrsim_regs.udr;
+}
+
+volatile uint8_t *avrsim_portb(void)
+{
+  sync();
+  sim.lasthook = HOOK_OTHER;
+  return &avrsim_regs.portb;
+}
+
+volatile uint16_t *avrsim_tcnt1(void)
+{
+  sync();
+  sim.lasthook = HOOK_OTHER;
+  sim.tcntwritten = 1;
+  sim.tcnttime = sim.now;
+  return &avrsim_regs.tcnt1;
+}
+
+void avrsim_cli(void)
+{
+  sync();
+  sim.udrread = sim.lasthook == HOOK_UCSRA_RXC;
+  sim.lasthook = HOOK_OTHER;
+  sim.ienable = 0;
+}
+
+void avrsim_sei(void)
+{
+  sim.ienable = 1;
+  sim.lasthook = HOOK_OTHER;
+  sync();
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+  return sim.eeprom[(uintptr_t) addr % EESIZE];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+  sim.eeprom[(uintptr_t) addr % EESIZE] = value;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+    ((uint8_t *) dst)[i] = eeprom_read_byte((const uint8_t *) src + i);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+    eeprom_write_byte((uint8_t *) dst + i, ((const uint8_t *) src)[i]);
+}
+
+void avrsim_run(const struct avrsim_io *io, uint64_t start, uint64_t end)
+{
+  size_t eesize = __stop_avrsim_eeprom - __start_avrsim_eeprom;
+
+  memset(&sim, 0, sizeof(sim));
+  memset(&avrsim_regs, 0, sizeof(avrsim_regs));
+  sim.io = io;
+  sim.now = start;
+  sim.end = end;
+  sim.txdone = start;
+  sim.overflow = start + 65536 * 128;
+  memset(sim.eeprom, 0xFF, EESIZE);
+  if (__start_avrsim_eeprom != NULL)
+    memcpy(sim.eeprom, __start_avrsim_eeprom, eesize < EESIZE ? eesize : EESIZE);
+  if (io->eeprom != NULL)
+    memcpy(sim.eeprom, io->eeprom, io->eepromlen < EESIZE ? io->eepromlen : EESIZE);
+
+  if (setjmp(sim.stop) == 0) firmware_main();
+}
+
+uint64_t avrsim_now(void)
+{
+  return sim.now;
+}
+
+int avrsim_intimer(void)
+{
+  return sim.intimer;
+}
+
+const struct avrsim_stats *avrsim_stats(void)
+{
+  return &sim.stats;
+}
@@ -0,0 +1,79 @@
+/*  avrsim.h  runs the VS4T1 firmware on the host against simulated
+              ATTiny2313 registers, a UART and timer1, in virtual time
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    the firmware is compiled unchanged with -I libx10/avrhost, whose
+    avr/ headers map the registers with side effects onto the hook
+    functions below and rename its main() to firmware_main().
+
+    time is virtual, in microseconds.  firmware code takes no time except
+    for the busy delay in TransmitByte and the UART byte times; when the
+    main loop reads UCSRA twice in a row with no byte waiting it is idle,
+    and time jumps to the next received byte or timer1 overflow; a second
+    read while the transmit buffer is full jumps to when it frees.
+    the UART models line rate from UBRRL/U2X, the two byte receive FIFO
+    (later bytes are overruns and dropped) and the transmit buffer.
+    a UDR access is a read when it is the first after a cli() that
+    followed a UCSRA read showing RXC, which is how the main loops read
+    a byte; every other UDR access is a write.  TCNT1 is only written
+*/
+
+#ifndef AVRSIM_H
+#define AVRSIM_H
+
+#include <stdint.h>
+
+#define AVRSIM_TXLOOP 1260	/* TransmitByte delay loop, microseconds */
+#define AVRSIM_RXFIFO 3		/* 2 byte FIFO and the shift register */
+
+struct avrsim_registers {
+  volatile uint8_t ucsra, ucsrb, ucsrc, ubrrh, ubrrl, udr;
+  volatile uint8_t portb, ddrb, ddrd, timsk, tccr1b;
+  volatile uint16_t tcnt1;
+};
+
+extern struct avrsim_registers avrsim_regs;
+
+volatile uint8_t *avrsim_ucsra(void);
+volatile uint8_t *avrsim_udr(void);
+volatile uint8_t *avrsim_portb(void);
+volatile uint16_t *avrsim_tcnt1(void);
+void avrsim_cli(void);
+void avrsim_sei(void);
+
+/* the firmware's timer1 overflow handler and main */
+void avrsim_timer1_ovf(void);
+int firmware_main(void);
+
+/* the world outside the chip, all callbacks but rx may be NULL */
+struct avrsim_io {
+  /* the next byte the receiver sends and the time it starts on the
+     line, without taking it: 1, or 0 when there are no more.  it is
+     asked again after every byte the firmware sends, so an emulated
+     receiver can answer the firmware */
+  int (*rx)(void *ctx, uint64_t *t, unsigned char *byte);
+  void (*rxtake)(void *ctx);
+  void (*tx)(void *ctx, uint64_t t, unsigned char byte);
+  void (*portb)(void *ctx, uint64_t t, unsigned char old, unsigned char now);
+  /* virtual time is about to jump, for pacing against the wall clock */
+  void (*idle)(void *ctx, uint64_t from, uint64_t to);
+  void *ctx;
+  /* EEPROM contents to start with instead of the firmware's EEMEM */
+  const unsigned char *eeprom;
+  int eepromlen;
+};
+
+struct avrsim_stats {
+  uint64_t rxbytes, txbytes, overruns, interrupts, portbchanges;
+};
+
+/* runs firmware_main from reset at time start until time end, or with
+   end 0 until the receiver has nothing more and the firmware is idle */
+void avrsim_run(const struct avrsim_io *io, uint64_t start, uint64_t end);
+uint64_t avrsim_now(void);
+/* 1 while the timer1 handler runs, so in its PORTB and tx callbacks */
+int avrsim_intimer(void);
+const struct avrsim_stats *avrsim_stats(void);
+
+#endif
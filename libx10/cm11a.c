@@ -0,0 +1,263 @@
+/*  cm11a.c  the PC end of a CM11A serial line
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "cm11a.h"
+#include "x10cap.h"
+
+#define BUFSIZE 256
+
+enum { TX_IDLE, TX_SUM, TX_READY };
+
+/* nothing of an upload is outstanding */
+#define rxidle(rx) ((rx)->count == 0 || (rx)->have == (rx)->count)
+
+int cm11a_open(const char *path)
+{
+  struct termios tios;
+  int fd = open(path, O_RDWR);
+
+  if (fd < 0) return -1;
+  /* set up the serial line in raw mode, 4800 baud */
+  tcgetattr(fd, &tios);
+  cfmakeraw(&tios);
+  cfsetospeed(&tios, B4800);
+  cfsetispeed(&tios, B4800);
+  tcsetattr(fd, TCSANOW, &tios);
+  return fd;
+}
+
+void cm11a_init(struct cm11a_port *p, int fd, const struct cm11a_hooks *hooks,
+		void *ctx)
+{
+  p->fd = fd;
+  p->hooks = hooks;
+  p->ctx = ctx;
+  cm11a_rx_init(&p->rx);
+  cm11a_encode_timeset(p->timeset, NULL, 0);
+  p->txhead = p->txlen = 0;
+  p->txstate = TX_IDLE;
+  p->quietuntil = p->lastrx = 0;
+  memset(&p->txstats, 0, sizeof(p->txstats));
+  p->textlen = 0;
+}
+
+int cm11a_write(struct cm11a_port *p, const unsigned char *buf, int n)
+{
+  int done = write(p->fd, buf, n);
+
+  if (done > 0 && p->hooks->traffic) p->hooks->traffic(p, buf, done, X10CAP_TX);
+  return done;
+}
+
+/* the pair at the head of the queue goes out, if the line is free */
+static void txstart(struct cm11a_port *p, uint64_t now)
+{
+  if (p->txstate != TX_IDLE || p->txlen == 0 || !rxidle(&p->rx)
+      || now < p->quietuntil) return;
+  cm11a_write(p, p->txq[p->txhead], 2);
+  p->txstate = TX_SUM;
+  p->txdeadline = now + CM11A_SUMWAIT;
+}
+
+static void txpop(struct cm11a_port *p)
+{
+  p->txhead = (p->txhead + 1) % CM11A_TXQUEUE;
+  p->txlen--;
+  p->txtries = 0;
+  p->txstate = TX_IDLE;
+}
+
+/* the pair at the head didn't go, try it again or give up on it */
+static void txagain(struct cm11a_port *p, uint64_t now)
+{
+  p->txstate = TX_IDLE;
+  if (++p->txtries >= CM11A_TXTRIES) {
+    p->txstats.failed++;
+    txpop(p);
+  } else p->txstats.retries++;
+  txstart(p, now);
+}
+
+/* a byte for the transmit in progress, returns 0 if it isn't one */
+static int txbyte(struct cm11a_port *p, unsigned char byte, uint64_t now)
+{
+  static const unsigned char anull = CM11A_ACK;
+  uint64_t lat;
+
+  if (!rxidle(&p->rx)) return 0;
+  if (p->txstate == TX_SUM) {
+    if (byte == cm11a_checksum(p->txq[p->txhead])) {
+      cm11a_write(p, &anull, 1);
+      p->txstate = TX_READY;
+      p->txdeadline = now + CM11A_READYWAIT;
+      return 1;
+    }
+    /* the CM11A wants serving first, the pair goes again after */
+    if (byte == CM11A_POLL || byte == CM11A_TIMEREQ) {
+      p->txstats.interrupts++;
+      p->txstate = TX_IDLE;
+      return 0;
+    }
+    txagain(p, now);
+    return 1;
+  }
+  if (p->txstate == TX_READY && byte == CM11A_READY) {
+    lat = now - p->txqueued[p->txhead];
+    p->txstats.sent++;
+    p->txstats.latsum += lat;
+    if (lat > p->txstats.latmax) p->txstats.latmax = lat;
+    txpop(p);
+    return 1;
+  }
+  return 0;
+}
+
+int cm11a_queue(struct cm11a_port *p, const unsigned char *pair)
+{
+  int i;
+
+  if (p->txlen == CM11A_TXQUEUE) return -1;
+  i = (p->txhead + p->txlen++) % CM11A_TXQUEUE;
+  p->txq[i][0] = pair[0];
+  p->txq[i][1] = pair[1];
+  p->txqueued[i] = x10cap_now();
+  txstart(p, p->txqueued[i]);
+  return 0;
+}
+
+int cm11a_send(struct cm11a_port *p, const struct x10_cmd *cmd, int dims)
+{
+  unsigned char pair[2];
+
+  if (p->txlen + (cmd->unit != X10_NOUNIT) + 1 > CM11A_TXQUEUE) return -1;
+  if (cmd->unit != X10_NOUNIT) {
+    cm11a_encode_addr(pair, cmd->house, cmd->unit);
+    cm11a_queue(p, pair);
+  }
+  cm11a_encode_func(pair, cmd->house, cmd->func, dims < 0 ? 0 : dims > 22 ? 22 : dims);
+  return cm11a_queue(p, pair);
+}
+
+uint64_t cm11a_deadline(const struct cm11a_port *p)
+{
+  uint64_t t = UINT64_MAX;
+
+  if (p->txstate != TX_IDLE) t = p->txdeadline;
+  else if (p->txlen > 0 && p->quietuntil > 0) t = p->quietuntil;
+  if (!rxidle(&p->rx) && p->lastrx + CM11A_UPLOADWAIT < t)
+    t = p->lastrx + CM11A_UPLOADWAIT;
+  return t;
+}
+
+int cm11a_polltimeout(const struct cm11a_port *p)
+{
+  uint64_t deadline = cm11a_deadline(p), now = x10cap_now();
+
+  if (deadline == UINT64_MAX) return -1;
+  return deadline <= now ? 0 : (int) ((deadline - now + 999) / 1000);
+}
+
+void cm11a_tick(struct cm11a_port *p)
+{
+  uint64_t now = x10cap_now();
+
+  /* an upload that lost bytes would otherwise hold the line forever */
+  if (!rxidle(&p->rx) && now >= p->lastrx + CM11A_UPLOADWAIT) cm11a_rx_init(&p->rx);
+  if (p->quietuntil > 0 && now >= p->quietuntil) p->quietuntil = 0;
+
+  if (p->txstate != TX_IDLE && now >= p->txdeadline) {
+    p->txstats.timeouts++;
+    /* without the 0x55 the code most likely went, don't send it twice */
+    if (p->txstate == TX_READY) txpop(p);
+    else {
+      txagain(p, now);
+      return;
+    }
+  }
+  txstart(p, now);
+}
+
+int cm11a_read(struct cm11a_port *p)
+{
+  /* these codes are sent back to x10 interface */
+  static const unsigned char anull = CM11A_ACK;
+  static const unsigned char pollback = CM11A_POLLACK;
+  unsigned char buf[BUFSIZE];
+  int numread, i, what;
+  uint64_t now;
+
+  numread = read(p->fd, buf, sizeof(buf));
+  if (numread <= 0) return numread;
+  if (p->hooks->traffic) p->hooks->traffic(p, buf, numread, X10CAP_RX);
+  now = p->lastrx = x10cap_now();
+
+  for (i = 0; i < numread; ++i) {
+    if (p->txstate != TX_IDLE && txbyte(p, buf[i], now)) continue;
+    what = cm11a_rx_byte(&p->rx, buf[i]);
+    if (what == CM11A_RX_NONE) continue;
+    if (p->hooks->event) p->hooks->event(p, what);
+
+    switch (what) {
+    case CM11A_RX_POLL:
+      cm11a_write(p, &pollback, 1);
+      p->quietuntil = now + CM11A_UPLOADWAIT;
+      break;
+    case CM11A_RX_NULL:
+      cm11a_write(p, &anull, 1);
+      break;
+    case CM11A_RX_TIMEREQ:
+      cm11a_write(p, p->timeset, sizeof(p->timeset));
+      p->quietuntil = now + CM11A_UPLOADWAIT;
+      break;
+    case CM11A_RX_READY:
+      p->quietuntil = 0;
+      break;
+    case CM11A_RX_BADCOUNT:
+      /* unsynchronized, numbytes can't be > 9, discard buffer */
+      i = numread;
+      p->quietuntil = 0;
+      break;
+    case CM11A_RX_UPLOAD:
+      p->quietuntil = 0;
+      if (p->hooks->upload) p->hooks->upload(p, &p->rx);
+      break;
+    }
+  }
+  txstart(p, now);
+  return numread;
+}
+
+int cm11a_read_text(struct cm11a_port *p)
+{
+  struct cm11a_rx rx;
+  unsigned int value;
+  char type, *line, *eol;
+  int n;
+
+  n = read(p->fd, p->text + p->textlen, sizeof(p->text) - p->textlen);
+  if (n <= 0) return n;
+  p->textlen += n;
+  line = p->text;
+  while ((eol = memchr(line, '\n', p->text + p->textlen - line)) != NULL) {
+    *eol = '\0';
+    if (sscanf(line, "%c %X", &type, &value) == 2 && p->hooks->upload) {
+      rx.count = rx.have = 2;
+      rx.buf[0] = type == 'F';
+      rx.buf[1] = value;
+      p->hooks->upload(p, &rx);
+    }
+    line = eol + 1;
+  }
+  p->textlen -= line - p->text;
+  memmove(p->text, line, p->textlen);
+  /* a line that fills the buffer is thrown away */
+  if (p->textlen == sizeof(p->text)) p->textlen = 0;
+  return n;
+}
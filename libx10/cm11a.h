@@ -0,0 +1,104 @@
+/*  cm11a.h  the PC end of a CM11A serial line
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    the serial loop rawx10 grew up with, for any tool that sits on a
+    CM11A:  answers polls, nulls and time requests as they come in and
+    hands each complete upload to the caller.  it never blocks on its
+    own, the caller reads when the fd is readable (poll() with other
+    fds, or just a blocking read loop)
+
+    transmits are queued as header/code pairs and each goes through
+    pair -> checksum back -> 0x00 -> 0x55 ready.  the next pair goes out
+    as soon as the 0x55 for the last one is read, a wrong checksum sends
+    the pair again, and a poll or time request that comes instead of the
+    checksum is served first, with the pair sent again after.  every
+    caller calls cm11a_tick by cm11a_deadline for the timeouts, an
+    upload that lost a byte is dropped there too
+*/
+
+#ifndef CM11A_H
+#define CM11A_H
+
+#include <stdint.h>
+#include "x10.h"
+
+#define CM11A_TXQUEUE 256	/* header/code pairs */
+#define CM11A_TXTRIES 5
+#define CM11A_SUMWAIT 500000	/* microseconds for the checksum */
+#define CM11A_READYWAIT 5000000	/* for the 0x55, the code is on the powerline */
+#define CM11A_UPLOADWAIT 500000	/* for an upload after 0xC3, or between its bytes */
+#define CM11A_TEXTBUF 4096	/* rawx10 lines not read to their end yet */
+
+struct cm11a_port;
+
+struct cm11a_hooks {
+  /* every byte read (X10CAP_RX) or written (X10CAP_TX), for capture */
+  void (*traffic)(struct cm11a_port *p, const unsigned char *buf, int n, int dir);
+  /* each complete upload, walk it with the cm11a_upload_ macros */
+  void (*upload)(struct cm11a_port *p, const struct cm11a_rx *rx);
+  /* each cm11a_rx_byte result other than CM11A_RX_NONE, for debugging */
+  void (*event)(struct cm11a_port *p, int what);
+};
+
+struct cm11a_txstats {
+  uint64_t sent;	/* pairs the CM11A took */
+  uint64_t retries;	/* pairs sent again after a bad checksum */
+  uint64_t interrupts;	/* polls or time requests instead of a checksum */
+  uint64_t timeouts;	/* no checksum or no 0x55 in time */
+  uint64_t failed;	/* pairs given up after CM11A_TXTRIES */
+  uint64_t latsum, latmax;	/* queued to 0x55, microseconds */
+};
+
+struct cm11a_port {
+  int fd;
+  struct cm11a_rx rx;
+  unsigned char timeset[7];
+  const struct cm11a_hooks *hooks;
+  void *ctx;
+  /* transmit queue, a ring of header/code pairs */
+  unsigned char txq[CM11A_TXQUEUE][2];
+  uint64_t txqueued[CM11A_TXQUEUE];
+  int txhead, txlen, txstate, txtries;
+  uint64_t txdeadline;
+  uint64_t quietuntil;	/* the CM11A owes an upload or a 0x55 */
+  uint64_t lastrx;
+  struct cm11a_txstats txstats;
+  char text[CM11A_TEXTBUF];	/* for cm11a_read_text */
+  int textlen;
+};
+
+/* opens a serial port raw at 4800 baud, -1 if it can't */
+int cm11a_open(const char *path);
+
+void cm11a_init(struct cm11a_port *p, int fd, const struct cm11a_hooks *hooks,
+		void *ctx);
+
+/* does one read() and deals with what came in, returns what read()
+   did:  bytes read, 0 at end of file, -1 with errno on error */
+int cm11a_read(struct cm11a_port *p);
+
+/* for a tool reading rawx10 output instead of a port:  does one read()
+   of "A 0x66" lines and hands each code to the upload hook as an
+   upload of its own, returns what read() did */
+int cm11a_read_text(struct cm11a_port *p);
+
+/* writes to the CM11A, through the traffic hook */
+int cm11a_write(struct cm11a_port *p, const unsigned char *buf, int n);
+
+/* queues a command:  an address pair when cmd->unit isn't X10_NOUNIT,
+   then the function pair, dims 0-22 for dim and bright.  returns -1
+   when the queue has no room for it */
+int cm11a_send(struct cm11a_port *p, const struct x10_cmd *cmd, int dims);
+/* queues one header/code pair */
+int cm11a_queue(struct cm11a_port *p, const unsigned char *pair);
+#define cm11a_pending(p) ((p)->txlen)
+
+/* next time, in x10cap_now microseconds, cm11a_tick has something to
+   do, UINT64_MAX for nothing */
+uint64_t cm11a_deadline(const struct cm11a_port *p);
+/* cm11a_deadline as a poll() timeout in ms, -1 for none */
+int cm11a_polltimeout(const struct cm11a_port *p);
+void cm11a_tick(struct cm11a_port *p);
+
+#endif
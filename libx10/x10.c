@@ -0,0 +1,236 @@
+/*  x10.c  X-10 code tables and CM11A/MR26A protocol encoders and decoders
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+*/
+
+#include <string.h>
+#include <strings.h>
+#include "x10.h"
+
+const unsigned char x10_code[17] = X10_CODES;
+
+/* inverse of X10_CODES, the old codex10 hcode/devcode tables */
+const unsigned char x10_index[16] = {12, 4, 2, 10, 14, 6, 0, 8,
+				     13, 5, 3, 11, 15, 7, 1, 9};
+
+const char *const x10_funcname[16] = {
+  "All_Units_Off", "All_Lights_On", "On", "Off",
+  "Dim", "Bright", "All_Lights_Off", "Extended_Code",
+  "Hail_Request", "Hail_Acknowledge",
+  "Pre-set_Dim(1)", "Pre-set_Dim(2)",
+  "Extended_Data_Transfer", "Status_On",
+  "Status_Off", "Status_Request"};
+
+/* dim and bright carry one byte, extended code two */
+const unsigned char x10_datacount[16] = {0, 0, 0, 0, 1, 1, 0, 2,
+					 0, 0, 0, 0, 0, 0, 0, 0};
+
+static const unsigned char mr26a_house[17] = MR26A_HOUSES;
+
+/* inverse of MR26A_HOUSES */
+static const unsigned char mr26a_index[16] = {12, 13, 14, 15, 2, 3, 0, 1,
+					      4, 5, 6, 7, 10, 11, 8, 9};
+
+int x10_parse_house(int letter)
+{
+  if (letter >= 'a' && letter <= 'p') letter -= 0x20;
+  if (letter < 'A' || letter > 'P') return -1;
+  return x10_code[letter - 'A'];
+}
+
+int x10_parse_unit(int unit)
+{
+  if (unit < 1 || unit > 16) return -1;
+  return x10_code[unit - 1];
+}
+
+int x10_parse_func(const char *name)
+{
+  int i;
+
+  for (i = 0; i < 16; ++i)
+    if (strcasecmp(name, x10_funcname[i]) == 0) return i;
+  return -1;
+}
+
+void cm11a_rx_init(struct cm11a_rx *rx)
+{
+  rx->count = rx->have = 0;
+}
+
+/* the first byte of an upload is the number of bytes to follow, the
+   second a bitmask with one bit per following byte, 1 for a function
+   and 0 for an address or data.  inside an upload every byte is data,
+   outside one the single byte messages are recognised first.
+   a complete upload stays in the state until the next byte */
+int cm11a_rx_byte(struct cm11a_rx *rx, unsigned char byte)
+{
+  if (rx->count > 0 && rx->have == rx->count) rx->count = 0;
+
+  if (rx->count > 0) {
+    rx->buf[rx->have++] = byte;
+    return rx->have < rx->count ? CM11A_RX_NONE : CM11A_RX_UPLOAD;
+  }
+
+  switch (byte) {
+  case CM11A_POLL:
+    return CM11A_RX_POLL;
+  case CM11A_TIMEREQ:
+    return CM11A_RX_TIMEREQ;
+  case CM11A_READY:
+    return CM11A_RX_READY;
+  case CM11A_ACK:
+    return CM11A_RX_NULL;
+  }
+  if (byte > CM11A_MAXUPLOAD) return CM11A_RX_BADCOUNT;
+  rx->count = byte;
+  rx->have = 0;
+  return CM11A_RX_NONE;
+}
+
+int cm11a_encode_upload(unsigned char *out, const unsigned char *codes,
+			unsigned int funcmask, int n)
+{
+  if (n < 1 || n >= CM11A_MAXUPLOAD) return -1;
+  out[0] = n + 1;
+  out[1] = funcmask;
+  memcpy(out + 2, codes, n);
+  return n + 2;
+}
+
+void cm11a_encode_addr(unsigned char *out, int house, int unit)
+{
+  out[0] = CM11A_HDR_ADDR;
+  out[1] = (house << 4) | unit;
+}
+
+/* dims is the 0-22 dim/bright step count for those functions */
+void cm11a_encode_func(unsigned char *out, int house, int func, int dims)
+{
+  out[0] = (dims << 3) | CM11A_HDR_FUNC;
+  out[1] = (house << 4) | func;
+}
+
+int cm11a_encode_timeset(unsigned char *out, const struct tm *tm, int house)
+{
+  memset(out, 0, 7);
+  out[0] = CM11A_TIMESET;
+  if (tm != NULL) {
+    out[1] = tm->tm_sec;
+    out[2] = tm->tm_min + 60 * (tm->tm_hour & 1);
+    out[3] = tm->tm_hour >> 1;
+    out[4] = tm->tm_yday & 0xFF;
+    out[5] = ((tm->tm_yday >> 1) & 0x80) | (1 << tm->tm_wday);
+  }
+  out[6] = house << 4;
+  return 7;
+}
+
+void mr26a_rx_init(struct mr26a_rx *rx)
+{
+  rx->have = 0;
+}
+
+/* could byte be at position pos of a frame */
+static int mr26a_fits(int pos, unsigned char byte)
+{
+  switch (pos) {
+  case 0:
+    return byte == MR26A_SYNC1;
+  case 1:
+    return byte == MR26A_SYNC2;
+  case MR26A_FRAMELEN - 1:
+    return byte == MR26A_END;
+  }
+  return 1;
+}
+
+/* sliding window sync: on a mismatch the window moves on to the next
+   place in the bytes already held where a frame could start */
+int mr26a_rx_byte(struct mr26a_rx *rx, unsigned char byte)
+{
+  int start, i;
+
+  rx->buf[rx->have++] = byte;
+  for (start = 0; start < rx->have; ++start) {
+    for (i = start; i < rx->have && mr26a_fits(i - start, rx->buf[i]); ++i);
+    if (i == rx->have) break;
+  }
+  if (start > 0) {
+    memmove(rx->buf, rx->buf + start, rx->have - start);
+    rx->have -= start;
+  }
+  if (rx->have < MR26A_FRAMELEN) return 0;
+  rx->have = 0;
+  return 1;
+}
+
+int mr26a_decode(const unsigned char *frame, struct x10_cmd *cmd)
+{
+  unsigned char hh = frame[2], uu = frame[3];
+  int unit;
+
+  if ((hh & 0x0F & ~MR26A_UNIT9) != 0) return -1;
+  cmd->house = x10_code[mr26a_index[hh >> 4]];
+
+  if (uu == MR26A_BRIGHT || uu == MR26A_DIM) {
+    if (hh & MR26A_UNIT9) return -1;
+    cmd->unit = X10_NOUNIT;	/* dims the last unit switched */
+    cmd->func = uu == MR26A_DIM ? X10_DIM : X10_BRIGHT;
+    return 0;
+  }
+  if (uu & 0x87) return -1;
+  unit = ((uu >> 4) & 1) | ((uu >> 2) & 2) | ((uu >> 4) & 4);
+  if (hh & MR26A_UNIT9) unit += 8;
+  cmd->unit = x10_code[unit];
+  cmd->func = (uu & MR26A_OFF) ? X10_OFF : X10_ON;
+  return 0;
+}
+
+int mr26a_encode(unsigned char *out, const struct x10_cmd *cmd)
+{
+  int unit = x10_index[cmd->unit & 0x0F];
+
+  out[0] = MR26A_SYNC1;
+  out[1] = MR26A_SYNC2;
+  out[2] = mr26a_house[x10_index[cmd->house & 0x0F]] << 4;
+  out[4] = MR26A_END;
+
+  switch (cmd->func) {
+  case X10_BRIGHT:
+    out[3] = MR26A_BRIGHT;
+    return 0;
+  case X10_DIM:
+    out[3] = MR26A_DIM;
+    return 0;
+  case X10_ON:
+  case X10_OFF:
+    if (unit & 8) out[2] |= MR26A_UNIT9;
+    out[3] = ((unit & 1) << 4) | ((unit & 2) << 2) | ((unit & 4) << 4);
+    if (cmd->func == X10_OFF) out[3] |= MR26A_OFF;
+    return 0;
+  }
+  return -1;
+}
+
+void mr26a_dedupe_init(struct mr26a_dedupe *d, uint64_t window,
+		       unsigned int minframes)
+{
+  memset(d, 0, sizeof(*d));
+  d->window = window;
+  d->minframes = minframes > 1 ? minframes : 1;
+}
+
+int mr26a_newpress(struct mr26a_dedupe *d, const struct x10_cmd *cmd, uint64_t t)
+{
+  unsigned int k = (cmd->house & 0x0F) << 8 | (cmd->unit & 0x0F) << 4 | (cmd->func & 0x0F);
+
+  if (d->window == 0) return 1;
+  if (d->seen[k].count > 0 && t - d->seen[k].last < d->window) {
+    d->seen[k].last = t;
+    return ++d->seen[k].count == d->minframes;
+  }
+  d->seen[k].last = t;
+  d->seen[k].count = 1;
+  return d->minframes == 1;
+}
@@ -0,0 +1,145 @@
+/*  x10.h  X-10 code tables and CM11A/MR26A protocol encoders and decoders
+           for the host tools and the host build of the firmware
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    all tables are constant and built at compile time, the encoders and
+    decoders work on caller owned state and buffers and never allocate
+*/
+
+#ifndef X10_H
+#define X10_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "x10codes.h"
+
+/* 4 bit house/unit code for index 0-15 (A-P or 1-16), and back */
+extern const unsigned char x10_code[17];
+extern const unsigned char x10_index[16];
+
+#define x10_house_letter(code) ('A' + x10_index[(code) & 0x0F])
+#define x10_unit_number(code) (1 + x10_index[(code) & 0x0F])
+
+/* function names as printed by codex10, and the number of data
+   bytes that follow each function in a CM11A upload */
+extern const char *const x10_funcname[16];
+extern const unsigned char x10_datacount[16];
+
+/* house letter A-P (either case) to code, -1 if not a house */
+int x10_parse_house(int letter);
+/* unit number 1-16 to code, -1 if out of range */
+int x10_parse_unit(int unit);
+/* function name, any case, to function code, -1 if unknown */
+int x10_parse_func(const char *name);
+
+/* a decoded X-10 command, all fields are 4 bit codes except a unit
+   of X10_NOUNIT for functions that don't name one */
+#define X10_NOUNIT 0xFF
+
+struct x10_cmd {
+  unsigned char house;
+  unsigned char unit;
+  unsigned char func;
+};
+
+/* CM11A serial protocol, PC side */
+
+enum {
+  CM11A_RX_NONE,	/* byte taken, nothing complete yet */
+  CM11A_RX_POLL,	/* answer with CM11A_POLLACK */
+  CM11A_RX_TIMEREQ,	/* answer with a time download */
+  CM11A_RX_READY,
+  CM11A_RX_NULL,	/* answer with CM11A_ACK */
+  CM11A_RX_UPLOAD,	/* an upload is complete in the state */
+  CM11A_RX_BADCOUNT	/* count byte over 9, unsynchronized */
+};
+
+struct cm11a_rx {
+  unsigned char count;	/* upload bytes expected, 0 when idle */
+  unsigned char have;
+  unsigned char buf[CM11A_MAXUPLOAD];	/* function mask, then codes */
+};
+
+void cm11a_rx_init(struct cm11a_rx *rx);
+int cm11a_rx_byte(struct cm11a_rx *rx, unsigned char byte);
+
+/* walking a complete upload, code i is 0 .. cm11a_upload_len-1 */
+#define cm11a_upload_len(rx) ((rx)->count - 1)
+#define cm11a_upload_isfunc(rx, i) (((rx)->buf[0] >> (i)) & 1)
+#define cm11a_upload_code(rx, i) ((rx)->buf[(i) + 1])
+
+/* CM11A side of an upload: count, function mask, codes
+   returns the bytes written to out (at most 10), -1 if n is not 1-8 */
+int cm11a_encode_upload(unsigned char *out, const unsigned char *codes,
+			unsigned int funcmask, int n);
+
+/* PC transmit header and code, checksum is the sum of the two */
+void cm11a_encode_addr(unsigned char *out, int house, int unit);
+void cm11a_encode_func(unsigned char *out, int house, int func, int dims);
+#define cm11a_checksum(p) (((p)[0] + (p)[1]) & 0xFF)
+
+/* PC time download, tm may be NULL for all zeros as rawx10 sends
+   returns the 7 bytes written */
+int cm11a_encode_timeset(unsigned char *out, const struct tm *tm, int house);
+
+/* batch decoding of CM11A codes
+   turns n raw code bytes, with bit i of funcmask (LSB first in each
+   byte) set when code i is a function, into one record per code.
+   datacount carries the Dim/Bright/Extended_Code data bytes still
+   expected from one call to the next, start it at 0.
+   x10_decode_batch uses byte shuffles (SSSE3 pshufb or NEON tbl) when
+   the CPU has them, x10_decode_batch_scalar is the table version */
+
+struct x10_rec {
+  unsigned char type;	/* 'A' address, 'F' function, 'D' data */
+  unsigned char house;	/* house letter, 0 for data */
+  unsigned char value;	/* unit 1-16, function code or data byte */
+  unsigned char raw;	/* the code byte as received */
+};
+
+void x10_decode_batch(const unsigned char *codes, const unsigned char *funcmask,
+		      size_t n, struct x10_rec *out, unsigned int *datacount);
+void x10_decode_batch_scalar(const unsigned char *codes,
+			     const unsigned char *funcmask, size_t n,
+			     struct x10_rec *out, unsigned int *datacount);
+
+/* MR26A frames */
+
+struct mr26a_rx {
+  unsigned char have;
+  unsigned char buf[MR26A_FRAMELEN];
+};
+
+void mr26a_rx_init(struct mr26a_rx *rx);
+/* returns 1 when buf holds a complete frame */
+int mr26a_rx_byte(struct mr26a_rx *rx, unsigned char byte);
+
+/* frame to command and back, encode writes MR26A_FRAMELEN bytes
+   both return 0, or -1 for codes an RF remote doesn't send */
+int mr26a_decode(const unsigned char *frame, struct x10_cmd *cmd);
+int mr26a_encode(unsigned char *out, const struct x10_cmd *cmd);
+
+/* a remote sends a press as a burst of repeats of one frame: a frame
+   is a new press when its house, unit and function weren't heard for
+   window microseconds.  with minframes over 1 a press is only reported
+   at that many frames, to pass over lone frames from interference.  a
+   window of 0 reports every frame */
+#define MR26A_DEDUPEWINDOW 250000	/* over two missed repeats */
+
+struct mr26a_dedupe {
+  uint64_t window;
+  unsigned int minframes;
+  struct {
+    uint64_t last;
+    unsigned int count;	/* frames in a row */
+  } seen[4096];		/* house << 8 | unit << 4 | function codes */
+};
+
+void mr26a_dedupe_init(struct mr26a_dedupe *d, uint64_t window,
+		       unsigned int minframes);
+/* returns 1 when the frame heard at t is a new press to report */
+int mr26a_newpress(struct mr26a_dedupe *d, const struct x10_cmd *cmd, uint64_t t);
+
+#endif
@@ -0,0 +1,373 @@
+/*  x10arc.c  columnar archive of decoded X-10 commands
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+*/
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "x10.h"
+#include "x10arc.h"
+
+static const unsigned char filemagic[8] = "X10ARC\0\1";
+static const unsigned char blockmagic[4] = "X10C";
+
+static void put16(unsigned char *p, unsigned int v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+  int i;
+
+  for (i = 0; i < 4; ++i) p[i] = v >> (8 * i);
+}
+
+static void put64(unsigned char *p, uint64_t v)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i) p[i] = v >> (8 * i);
+}
+
+static unsigned int get16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 |
+    (uint32_t) p[3] << 24;
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+  uint64_t v = 0;
+  int i;
+
+  for (i = 7; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+static unsigned char *putvarint(unsigned char *p, uint64_t v)
+{
+  while (v >= 0x80) {
+    *p++ = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+
+/* NULL if the varint runs past end */
+static const unsigned char *getvarint(const unsigned char *p,
+				      const unsigned char *end, uint64_t *v)
+{
+  int shift = 0;
+
+  *v = 0;
+  do {
+    if (p >= end || shift > 63) return NULL;
+    *v |= (uint64_t) (*p & 0x7F) << shift;
+    shift += 7;
+  } while (*p++ & 0x80);
+  return p;
+}
+
+static unsigned char *putruns(unsigned char *p, const unsigned char *v,
+			      unsigned int n)
+{
+  unsigned int i, run;
+
+  for (i = 0; i < n; i += run) {
+    for (run = 1; i + run < n && v[i + run] == v[i]; ++run);
+    p = putvarint(p, run);
+    *p++ = v[i];
+  }
+  return p;
+}
+
+/* -1 unless the column is exactly n values */
+static int getruns(const unsigned char *p, const unsigned char *end,
+		   unsigned char *v, unsigned int n)
+{
+  unsigned int i = 0;
+  uint64_t run;
+
+  while (p < end) {
+    p = getvarint(p, end, &run);
+    if (p == NULL || p >= end || run == 0 || run > n - i) return -1;
+    memset(v + i, *p++, run);
+    i += run;
+  }
+  return i == n ? 0 : -1;
+}
+
+static int writeall(int fd, const unsigned char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(fd, buf, len);
+    if (n < 0) return -1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* the position after the last whole block of an existing archive, a
+   block cut short by a crash is dropped.  -1 if it isn't an archive */
+static int64_t lastblock(struct x10arc_writer *w, uint64_t size)
+{
+  unsigned char hdr[X10ARC_BLOCKHDR];
+  uint64_t pos, len;
+
+  if (size < X10ARC_FILEHDR ||
+      pread(w->fd, hdr, X10ARC_FILEHDR, 0) != X10ARC_FILEHDR ||
+      memcmp(hdr, filemagic, sizeof(filemagic)) != 0 ||
+      get32(hdr + 8) != X10ARC_BLOCKHDR)
+    return -1;
+
+  for (pos = X10ARC_FILEHDR; pos + X10ARC_BLOCKHDR <= size; pos += len) {
+    if (pread(w->fd, hdr, X10ARC_BLOCKHDR, pos) != X10ARC_BLOCKHDR ||
+	memcmp(hdr, blockmagic, sizeof(blockmagic)) != 0)
+      break;
+    len = get32(hdr + 4);
+    if (len < X10ARC_BLOCKHDR || pos + len > size) break;
+    w->tlast = get64(hdr + 24);
+  }
+  if (pos < size && ftruncate(w->fd, pos) < 0) return -1;
+  return pos;
+}
+
+int x10arc_create(struct x10arc_writer *w, const char *path)
+{
+  struct stat st;
+  unsigned char hdr[X10ARC_FILEHDR];
+  int64_t pos = X10ARC_FILEHDR;
+
+  w->count = 0;
+  w->tlast = 0;
+  w->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (w->fd < 0) return -1;
+  if (fstat(w->fd, &st) < 0) pos = -1;
+  else if (st.st_size == 0) {
+    memset(hdr, 0, X10ARC_FILEHDR);
+    memcpy(hdr, filemagic, sizeof(filemagic));
+    put32(hdr + 8, X10ARC_BLOCKHDR);
+    if (pwrite(w->fd, hdr, X10ARC_FILEHDR, 0) != X10ARC_FILEHDR) pos = -1;
+  } else pos = lastblock(w, st.st_size);
+
+  if (pos < 0 || lseek(w->fd, pos, SEEK_SET) < 0) {
+    close(w->fd);
+    return -1;
+  }
+  return 0;
+}
+
+int x10arc_put(struct x10arc_writer *w, const struct x10arc_rec *rec)
+{
+  struct x10arc_rec *r;
+
+  if (w->count == X10ARC_BLOCKRECS && x10arc_flush(w) < 0) return -1;
+  r = &w->recs[w->count++];
+  *r = *rec;
+  /* times never go backwards inside an archive */
+  if (r->t < w->tlast) r->t = w->tlast;
+  w->tlast = r->t;
+  return 0;
+}
+
+int x10arc_flush(struct x10arc_writer *w)
+{
+  unsigned char v[X10ARC_BLOCKRECS];
+  unsigned char *hdr = w->block, *p, *colstart;
+  const struct x10arc_rec *r;
+  unsigned int i, j, n = w->count, funcmask = 0;
+  int col;
+  uint64_t t;
+
+  if (n == 0) return 0;
+  memset(hdr, 0, X10ARC_BLOCKHDR);
+  p = colstart = hdr + X10ARC_BLOCKHDR;
+
+  t = w->recs[0].t;
+  for (i = 0; i < n; ++i) {
+    r = &w->recs[i];
+    p = putvarint(p, r->t - t);
+    t = r->t;
+    funcmask |= 1 << r->func;
+    if (r->unit == X10_NOUNIT)
+      for (j = 0; j < 16; ++j) hdr[32 + (r->house << 1) + (j >> 3)] |= 1 << (j & 7);
+    else
+      hdr[32 + (r->house << 1) + (r->unit >> 3)] |= 1 << (r->unit & 7);
+  }
+  put32(hdr + 64, p - colstart);
+
+  for (col = X10ARC_PORT; col <= X10ARC_FUNC; ++col) {
+    colstart = p;
+    for (i = 0; i < n; ++i) {
+      r = &w->recs[i];
+      switch (col) {
+      case X10ARC_PORT:
+	v[i] = r->port;
+	break;
+      case X10ARC_HOUSE:
+	v[i] = r->house;
+	break;
+      case X10ARC_UNIT:
+	v[i] = (r->unit == X10_NOUNIT ? X10ARC_HOUSECMD : r->unit) |
+	  (r->samecmd ? X10ARC_SAMECMD : 0);
+	break;
+      default:
+	v[i] = r->func;
+      }
+    }
+    p = putruns(p, v, n);
+    put32(hdr + 64 + 4 * col, p - colstart);
+  }
+
+  colstart = p;
+  for (i = 0; i < n; ++i)
+    for (j = 0; j < x10_datacount[w->recs[i].func]; ++j)
+      *p++ = w->recs[i].data[j];
+  put32(hdr + 64 + 4 * X10ARC_DATA, p - colstart);
+
+  memcpy(hdr, blockmagic, sizeof(blockmagic));
+  put32(hdr + 4, p - hdr);
+  put32(hdr + 8, n);
+  put16(hdr + 12, funcmask);
+  put64(hdr + 16, w->recs[0].t);
+  put64(hdr + 24, w->recs[n - 1].t);
+  if (writeall(w->fd, hdr, p - hdr) < 0) return -1;
+  w->count = 0;
+  return 0;
+}
+
+int x10arc_close(struct x10arc_writer *w)
+{
+  int err = x10arc_flush(w);
+
+  if (close(w->fd) < 0) err = -1;
+  return err;
+}
+
+int x10arc_open(struct x10arc_reader *r, const char *path)
+{
+  struct stat st;
+
+  r->map = NULL;
+  r->pos = X10ARC_FILEHDR;
+  r->fd = open(path, O_RDONLY);
+  if (r->fd < 0) return -1;
+  if (fstat(r->fd, &st) < 0 || st.st_size < X10ARC_FILEHDR) {
+    close(r->fd);
+    return -1;
+  }
+  r->size = st.st_size;
+  r->map = mmap(NULL, r->size, PROT_READ, MAP_SHARED, r->fd, 0);
+  if (r->map == MAP_FAILED) {
+    close(r->fd);
+    return -1;
+  }
+  if (memcmp(r->map, filemagic, sizeof(filemagic)) != 0 ||
+      get32(r->map + 8) != X10ARC_BLOCKHDR) {
+    x10arc_close_reader(r);
+    return -1;
+  }
+  return 0;
+}
+
+int x10arc_nextblock(struct x10arc_reader *r, struct x10arc_block *b)
+{
+  const unsigned char *hdr = r->map + r->pos;
+  uint64_t len, used = X10ARC_BLOCKHDR;
+  int col;
+
+  /* a block still being written ends the archive for now */
+  if (r->pos + X10ARC_BLOCKHDR > r->size) return 0;
+  len = get32(hdr + 4);
+  if (r->pos + len > r->size) return 0;
+  if (memcmp(hdr, blockmagic, sizeof(blockmagic)) != 0) return -1;
+
+  b->count = get32(hdr + 8);
+  b->funcmask = get16(hdr + 12);
+  b->tfirst = get64(hdr + 16);
+  b->tlast = get64(hdr + 24);
+  memcpy(b->units, hdr + 32, sizeof(b->units));
+  for (col = 0; col < X10ARC_NUMCOLS; ++col) {
+    b->col[col] = hdr + used;
+    b->collen[col] = get32(hdr + 64 + 4 * col);
+    used += b->collen[col];
+  }
+  if (used != len || b->count == 0 || b->count > X10ARC_BLOCKRECS) return -1;
+  r->pos += len;
+  return 1;
+}
+
+int x10arc_decode(const struct x10arc_block *b, int cols,
+		  struct x10arc_rec *out)
+{
+  unsigned char v[X10ARC_BLOCKRECS];
+  const unsigned char *p, *end;
+  unsigned int i, j, n = b->count;
+  uint64_t t, delta;
+  int col;
+
+  if (cols & (1 << X10ARC_DATA)) cols |= 1 << X10ARC_FUNC;
+
+  if (cols & (1 << X10ARC_TIME)) {
+    p = b->col[X10ARC_TIME];
+    end = p + b->collen[X10ARC_TIME];
+    t = b->tfirst;
+    for (i = 0; i < n; ++i) {
+      p = getvarint(p, end, &delta);
+      if (p == NULL) return -1;
+      t += delta;
+      out[i].t = t;
+    }
+  }
+
+  for (col = X10ARC_PORT; col <= X10ARC_FUNC; ++col) {
+    if (!(cols & (1 << col))) continue;
+    if (getruns(b->col[col], b->col[col] + b->collen[col], v, n) < 0) return -1;
+    for (i = 0; i < n; ++i)
+      switch (col) {
+      case X10ARC_PORT:
+	out[i].port = v[i];
+	break;
+      case X10ARC_HOUSE:
+	out[i].house = v[i] & 0x0F;
+	break;
+      case X10ARC_UNIT:
+	out[i].unit = v[i] & X10ARC_HOUSECMD ? X10_NOUNIT : v[i] & 0x0F;
+	out[i].samecmd = (v[i] & X10ARC_SAMECMD) != 0;
+	break;
+      default:
+	out[i].func = v[i] & 0x0F;
+      }
+  }
+
+  if (cols & (1 << X10ARC_DATA)) {
+    p = b->col[X10ARC_DATA];
+    end = p + b->collen[X10ARC_DATA];
+    for (i = 0; i < n; ++i) {
+      out[i].data[0] = out[i].data[1] = 0;
+      if (p + x10_datacount[out[i].func] > end) return -1;
+      for (j = 0; j < x10_datacount[out[i].func]; ++j) out[i].data[j] = *p++;
+    }
+  }
+  return 0;
+}
+
+void x10arc_close_reader(struct x10arc_reader *r)
+{
+  munmap((void *) r->map, r->size);
+  close(r->fd);
+}
@@ -0,0 +1,112 @@
+/*  x10arc.h  columnar archive of decoded X-10 commands
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    an archive keeps commands, not serial bytes: one record per unit a
+    function was sent to (or one for the whole house), with the wall
+    clock time it arrived and the port and protocol it came in on.
+    it is a file header followed by blocks of up to X10ARC_BLOCKRECS
+    records.  a block is a header, then each field in a column of its own
+        time    varint microseconds since the previous record, the first
+                is relative to the block's first time
+        port    run length coded: varint run, then the byte
+        house   run length coded 4 bit codes
+        unit    run length coded 4 bit codes, or X10ARC_HOUSECMD for the
+                whole house, with X10ARC_SAMECMD added when the record is
+                the same command as the one before (a CM11A group)
+        func    run length coded 4 bit codes
+        data    x10_datacount[func] bytes for each Dim, Bright and
+                Extended_Code record, nothing for the others
+    the block header gives its length, first and last time, a bitmap
+    of the house/unit pairs and one of the functions in it, so a reader
+    can pass over blocks it has no use for by their headers alone and
+    decode only the columns it needs.  a command to a whole house sets
+    all 16 units of the house in the bitmap.  all fields little endian
+*/
+
+#ifndef X10ARC_H
+#define X10ARC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define X10ARC_FILEHDR 16
+#define X10ARC_BLOCKHDR 96
+#define X10ARC_BLOCKRECS 4096
+/* longest block: 10 byte times, 2 bytes a record in each run length
+   column (runs of 1) and 2 data bytes */
+#define X10ARC_MAXBLOCK (X10ARC_BLOCKHDR + X10ARC_BLOCKRECS * 20)
+
+/* unit column flags */
+#define X10ARC_SAMECMD 0x10
+#define X10ARC_HOUSECMD 0x20
+
+/* columns, for x10arc_decode */
+enum {
+  X10ARC_TIME,
+  X10ARC_PORT,
+  X10ARC_HOUSE,
+  X10ARC_UNIT,
+  X10ARC_FUNC,
+  X10ARC_DATA,
+  X10ARC_NUMCOLS
+};
+#define X10ARC_ALLCOLS ((1 << X10ARC_NUMCOLS) - 1)
+
+struct x10arc_rec {
+  uint64_t t;		/* wall clock microseconds */
+  unsigned char port;	/* x10cap_meta(port, protocol, 0) */
+  unsigned char house;
+  unsigned char unit;	/* X10_NOUNIT for the whole house */
+  unsigned char func;
+  unsigned char samecmd;	/* same command as the record before */
+  unsigned char data[2];
+};
+
+struct x10arc_block {
+  unsigned int count;
+  unsigned int funcmask;	/* bit per function code */
+  uint64_t tfirst, tlast;
+  unsigned char units[32];	/* bit house << 4 | unit */
+  const unsigned char *col[X10ARC_NUMCOLS];
+  uint32_t collen[X10ARC_NUMCOLS];
+};
+
+#define x10arc_hasunit(b, house, unit) \
+  (((b)->units[((house) << 1) | ((unit) >> 3)] >> ((unit) & 7)) & 1)
+
+struct x10arc_writer {
+  int fd;
+  unsigned int count;
+  uint64_t tlast;
+  struct x10arc_rec recs[X10ARC_BLOCKRECS];
+  unsigned char block[X10ARC_MAXBLOCK];
+};
+
+struct x10arc_reader {
+  int fd;
+  const unsigned char *map;
+  uint64_t size, pos;
+};
+
+/* creates the file, or continues one that exists after its last whole
+   block, -1 on errors and for a file that isn't empty or an archive */
+int x10arc_create(struct x10arc_writer *w, const char *path);
+/* adds one record, writing out the block when it fills */
+int x10arc_put(struct x10arc_writer *w, const struct x10arc_rec *rec);
+/* writes out the records held as a block of their own */
+int x10arc_flush(struct x10arc_writer *w);
+int x10arc_close(struct x10arc_writer *w);
+
+/* maps the file as it is now */
+int x10arc_open(struct x10arc_reader *r, const char *path);
+/* header of the next block: 1, 0 at the end, -1 on a bad block */
+int x10arc_nextblock(struct x10arc_reader *r, struct x10arc_block *b);
+/* decodes the columns with bits in cols into out, b->count records,
+   the others are left alone.  data needs func and is decoded with it
+   returns -1 if a column is damaged */
+int x10arc_decode(const struct x10arc_block *b, int cols,
+		  struct x10arc_rec *out);
+void x10arc_close_reader(struct x10arc_reader *r);
+
+#endif
@@ -0,0 +1,166 @@
+/*  x10batch.c  batch decoding of CM11A code bytes into x10_rec records
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    the house letter and unit number are 16 entry lookups of a nibble in
+    x10_index, which is exactly what a byte shuffle does for 16 bytes at
+    once, so the vector paths do 16 codes per step without a branch.  data bytes
+    after Dim/Bright/Extended_Code depend on the codes before them, so
+    a group holding one of those functions, or starting with data still
+    expected, is patched up by the scalar loop afterwards
+*/
+
+#include "x10.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X10_SSSE3
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define X10_NEON
+#endif
+
+/* decodes records already typed 'A'/'F', turning the ones that carry
+   data into 'D' records */
+static void fixdata(struct x10_rec *out, size_t n, unsigned int *datacount)
+{
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    if (*datacount > 0) {
+      out[i].type = 'D';
+      out[i].house = 0;
+      out[i].value = out[i].raw;
+      (*datacount) --;
+    }
+    else if (out[i].type == 'F' && x10_datacount[out[i].value] > 0)
+      *datacount = x10_datacount[out[i].value];
+  }
+}
+
+void x10_decode_batch_scalar(const unsigned char *codes,
+			     const unsigned char *funcmask, size_t n,
+			     struct x10_rec *out, unsigned int *datacount)
+{
+  size_t i;
+  unsigned char c;
+
+  for (i = 0; i < n; ++i) {
+    c = codes[i];
+    out[i].house = x10_house_letter(c >> 4);
+    out[i].raw = c;
+    if ((funcmask[i >> 3] >> (i & 7)) & 1) {
+      out[i].type = 'F';
+      out[i].value = c & 0x0F;
+    } else {
+      out[i].type = 'A';
+      out[i].value = x10_unit_number(c);
+    }
+  }
+  fixdata(out, n, datacount);
+}
+
+#ifdef X10_SSSE3
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(const unsigned char *codes,
+			   const unsigned char *funcmask, size_t n,
+			   struct x10_rec *out, unsigned int *datacount)
+{
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i indextab = _mm_loadu_si128((const __m128i *) x10_index);
+  const __m128i datatab = _mm_loadu_si128((const __m128i *) x10_datacount);
+  const __m128i maskspread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+					   1, 1, 1, 1, 1, 1, 1, 1);
+  const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+				     1, 2, 4, 8, 16, 32, 64, -128);
+  const __m128i atype = _mm_set1_epi8('A'), ftype = _mm_set1_epi8('F');
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i v, lo, hi, isf, type, house, value, th, vr, needdata;
+  size_t i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    v = _mm_loadu_si128((const __m128i *) (codes + i));
+    lo = _mm_and_si128(v, nibble);
+    hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    house = _mm_add_epi8(_mm_shuffle_epi8(indextab, hi), atype);
+
+    /* spread the 16 mask bits over 16 bytes of 0x00 or 0xFF */
+    isf = _mm_cvtsi32_si128(funcmask[i >> 3] | (funcmask[(i >> 3) + 1] << 8));
+    isf = _mm_and_si128(_mm_shuffle_epi8(isf, maskspread), bits);
+    isf = _mm_cmpeq_epi8(isf, bits);
+
+    type = _mm_or_si128(_mm_and_si128(isf, ftype), _mm_andnot_si128(isf, atype));
+    value = _mm_add_epi8(_mm_shuffle_epi8(indextab, lo), one);
+    value = _mm_or_si128(_mm_and_si128(isf, lo), _mm_andnot_si128(isf, value));
+
+    /* interleave type, house, value, raw into 4 byte records */
+    th = _mm_unpacklo_epi8(type, house);
+    vr = _mm_unpacklo_epi8(value, v);
+    _mm_storeu_si128((__m128i *) (out + i), _mm_unpacklo_epi16(th, vr));
+    _mm_storeu_si128((__m128i *) (out + i + 4), _mm_unpackhi_epi16(th, vr));
+    th = _mm_unpackhi_epi8(type, house);
+    vr = _mm_unpackhi_epi8(value, v);
+    _mm_storeu_si128((__m128i *) (out + i + 8), _mm_unpacklo_epi16(th, vr));
+    _mm_storeu_si128((__m128i *) (out + i + 12), _mm_unpackhi_epi16(th, vr));
+
+    needdata = _mm_and_si128(isf, _mm_shuffle_epi8(datatab, lo));
+    needdata = _mm_cmpeq_epi8(needdata, _mm_setzero_si128());
+    if (*datacount > 0 || _mm_movemask_epi8(needdata) != 0xFFFF)
+      fixdata(out + i, 16, datacount);
+  }
+  return i;
+}
+#endif
+
+#ifdef X10_NEON
+static size_t decode_neon(const unsigned char *codes,
+			  const unsigned char *funcmask, size_t n,
+			  struct x10_rec *out, unsigned int *datacount)
+{
+  const uint8x16_t nibble = vdupq_n_u8(0x0F);
+  const uint8x16_t indextab = vld1q_u8(x10_index);
+  const uint8x16_t datatab = vld1q_u8(x10_datacount);
+  static const unsigned char bitvals[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+					    1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t bits = vld1q_u8(bitvals);
+  uint8x16x4_t rec;
+  uint8x16_t v, lo, isf, needdata;
+  size_t i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    v = vld1q_u8(codes + i);
+    lo = vandq_u8(v, nibble);
+    isf = vcombine_u8(vdup_n_u8(funcmask[i >> 3]),
+		      vdup_n_u8(funcmask[(i >> 3) + 1]));
+    isf = vtstq_u8(isf, bits);
+
+    rec.val[0] = vbslq_u8(isf, vdupq_n_u8('F'), vdupq_n_u8('A'));
+    rec.val[1] = vaddq_u8(vqtbl1q_u8(indextab, vshrq_n_u8(v, 4)), vdupq_n_u8('A'));
+    rec.val[2] = vbslq_u8(isf, lo, vaddq_u8(vqtbl1q_u8(indextab, lo), vdupq_n_u8(1)));
+    rec.val[3] = v;
+    vst4q_u8((unsigned char *) (out + i), rec);
+
+    needdata = vandq_u8(isf, vqtbl1q_u8(datatab, lo));
+    if (*datacount > 0 || vmaxvq_u8(needdata) != 0)
+      fixdata(out + i, 16, datacount);
+  }
+  return i;
+}
+#endif
+
+void x10_decode_batch(const unsigned char *codes, const unsigned char *funcmask,
+		      size_t n, struct x10_rec *out, unsigned int *datacount)
+{
+  size_t done = 0;
+
+#ifdef X10_SSSE3
+  if (__builtin_cpu_supports("ssse3"))
+    done = decode_ssse3(codes, funcmask, n, out, datacount);
+#endif
+#ifdef X10_NEON
+  done = decode_neon(codes, funcmask, n, out, datacount);
+#endif
+  /* the mask of the tail starts on a byte boundary, done is a multiple of 16 */
+  x10_decode_batch_scalar(codes + done, funcmask + (done >> 3), n - done,
+			  out + done, datacount);
+}
@@ -0,0 +1,399 @@
+/*  x10cap.c  timestamped binary capture of X-10 serial traffic
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+*/
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "x10cap.h"
+
+static const unsigned char filemagic[8] = "X10CAP\0\1";
+static const unsigned char blockmagic[4] = "X10B";
+
+/* little endian fields, so captures move between machines */
+static void put16(unsigned char *p, unsigned int v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put64(unsigned char *p, uint64_t v)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i) p[i] = v >> (8 * i);
+}
+
+static unsigned int get16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+  uint64_t v = 0;
+  int i;
+
+  for (i = 7; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+uint64_t x10cap_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* wall clock microseconds less the capture clock, as it is now */
+static int64_t wallanchor(void)
+{
+  struct timespec real;
+
+  clock_gettime(CLOCK_REALTIME, &real);
+  return (uint64_t) real.tv_sec * 1000000 + real.tv_nsec / 1000 - x10cap_now();
+}
+
+static void newblock(struct x10cap_writer *w)
+{
+  memset(w->block, 0, sizeof(w->block));
+  w->used = X10CAP_BLOCKHDR;
+  w->count = 0;
+}
+
+/* the header of a new file records where wall clock time is */
+static int newfile(struct x10cap_writer *w, int64_t anchor)
+{
+  unsigned char *hdr = w->block;
+
+  memset(hdr, 0, X10CAP_BLOCKSIZE);
+  memcpy(hdr, filemagic, sizeof(filemagic));
+  put64(hdr + 8, X10CAP_BLOCKSIZE);
+  put64(hdr + 16, anchor);
+  if (pwrite(w->fd, hdr, X10CAP_BLOCKSIZE, 0) != X10CAP_BLOCKSIZE) return -1;
+  w->blockno = 1;
+  w->tlast = 0;
+  w->shift = 0;
+  w->lastflush = 0;
+  newblock(w);
+  return 0;
+}
+
+/* the file header of an existing capture, -1 if it isn't one */
+static int readheader(struct x10cap_writer *w, const struct stat *st)
+{
+  unsigned char *hdr = w->block;
+
+  if (st->st_size < X10CAP_BLOCKSIZE ||
+      pread(w->fd, hdr, X10CAP_BLOCKSIZE, 0) != X10CAP_BLOCKSIZE ||
+      memcmp(hdr, filemagic, sizeof(filemagic)) != 0 ||
+      get64(hdr + 8) != X10CAP_BLOCKSIZE)
+    return -1;
+  return 0;
+}
+
+int x10cap_create(struct x10cap_writer *w, const char *path)
+{
+  struct stat st;
+  unsigned char *hdr = w->block;
+  uint64_t numblocks;
+
+  w->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (w->fd < 0) return -1;
+  if (fstat(w->fd, &st) < 0 ||
+      (st.st_size == 0 ? newfile(w, wallanchor()) : readheader(w, &st)) < 0) {
+    close(w->fd);
+    return -1;
+  }
+  if (st.st_size == 0) return 0;
+
+  /* existing file, carry on in its last block if that has room.  the
+     capture clock may have started over since, with a reboot, so new
+     times are moved onto the file's wall clock anchor */
+  w->shift = wallanchor() - (int64_t) get64(hdr + 16);
+  w->lastflush = 0;
+  numblocks = st.st_size / X10CAP_BLOCKSIZE;
+  w->blockno = numblocks;
+  w->tlast = 0;
+  newblock(w);
+  if (numblocks > 1 &&
+      pread(w->fd, w->block, X10CAP_BLOCKSIZE,
+	    (numblocks - 1) * X10CAP_BLOCKSIZE) == X10CAP_BLOCKSIZE &&
+      memcmp(w->block, blockmagic, sizeof(blockmagic)) == 0) {
+    w->tlast = get64(w->block + 16);
+    if (get16(w->block + 4) + X10CAP_MAXREC <= X10CAP_BLOCKSIZE) {
+      w->blockno = numblocks - 1;
+      w->used = get16(w->block + 4);
+      w->count = get16(w->block + 6);
+      w->tfirst = get64(w->block + 8);
+      return 0;
+    }
+  }
+  newblock(w);
+  return 0;
+}
+
+int x10cap_create_anchored(struct x10cap_writer *w, const char *path,
+			   int64_t anchor)
+{
+  w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (w->fd < 0) return -1;
+  if (newfile(w, anchor) < 0) {
+    close(w->fd);
+    return -1;
+  }
+  return 0;
+}
+
+int x10cap_put(struct x10cap_writer *w, uint64_t t, int meta,
+	       unsigned char byte)
+{
+  unsigned char *p;
+  uint64_t delta;
+
+  if (w->used + X10CAP_MAXREC > X10CAP_BLOCKSIZE) {
+    if (x10cap_flush(w) < 0) return -1;
+    w->blockno++;
+    newblock(w);
+  }
+
+  /* times never go backwards inside a file */
+  t += w->shift;
+  if ((int64_t) t < 0 || t < w->tlast) t = w->tlast;
+  if (w->count == 0) w->tfirst = w->tlast = t;
+  delta = t - w->tlast;
+  w->tlast = t;
+
+  p = w->block + w->used;
+  while (delta >= 0x80) {
+    *p++ = (delta & 0x7F) | 0x80;
+    delta >>= 7;
+  }
+  *p++ = delta;
+  *p++ = meta;
+  *p++ = byte;
+  w->used = p - w->block;
+  w->count++;
+  return 0;
+}
+
+int x10cap_flush(struct x10cap_writer *w)
+{
+  if (w->count == 0) return 0;
+  memcpy(w->block, blockmagic, sizeof(blockmagic));
+  put16(w->block + 4, w->used);
+  put16(w->block + 6, w->count);
+  put64(w->block + 8, w->tfirst);
+  put64(w->block + 16, w->tlast);
+  if (pwrite(w->fd, w->block, X10CAP_BLOCKSIZE,
+	     w->blockno * X10CAP_BLOCKSIZE) != X10CAP_BLOCKSIZE)
+    return -1;
+  return 0;
+}
+
+int x10cap_close(struct x10cap_writer *w)
+{
+  int err = x10cap_flush(w);
+
+  if (close(w->fd) < 0) err = -1;
+  return err;
+}
+
+int x10cap_putbytes(struct x10cap_writer *w, uint64_t t, int meta,
+		    const unsigned char *buf, int n)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    if (x10cap_put(w, t, meta, buf[i]) < 0) return -1;
+  if (t - w->lastflush >= X10CAP_FLUSHUS) {
+    w->lastflush = t;
+    return x10cap_flush(w);
+  }
+  return 0;
+}
+
+volatile sig_atomic_t x10cap_stopping = 0;
+
+static void stopcapture(int sig)
+{
+  x10cap_stopping = 1;
+}
+
+void x10cap_catchstop(void)
+{
+  struct sigaction sa;
+
+  /* no SA_RESTART, so the signals get a blocked read() back */
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stopcapture;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+}
+
+static uint64_t filesize(int fd)
+{
+  struct stat st;
+
+  return fstat(fd, &st) < 0 ? 0 : (uint64_t) st.st_size;
+}
+
+int x10cap_open(struct x10cap_reader *r, const char *path, int usemap)
+{
+  uint64_t size;
+
+  r->map = NULL;
+  r->block = NULL;
+  r->blockno = 0;
+  r->pos = r->used = 0;
+  r->fd = open(path, O_RDONLY);
+  if (r->fd < 0) return -1;
+
+  size = filesize(r->fd);
+  if (size < X10CAP_BLOCKSIZE ||
+      pread(r->fd, r->buf, X10CAP_BLOCKSIZE, 0) != X10CAP_BLOCKSIZE ||
+      memcmp(r->buf, filemagic, sizeof(filemagic)) != 0 ||
+      get64(r->buf + 8) != X10CAP_BLOCKSIZE) {
+    close(r->fd);
+    return -1;
+  }
+  r->anchor = get64(r->buf + 16);
+  r->numblocks = size / X10CAP_BLOCKSIZE - 1;
+
+  if (usemap) {
+    r->map = mmap(NULL, (r->numblocks + 1) * X10CAP_BLOCKSIZE, PROT_READ,
+		  MAP_SHARED, r->fd, 0);
+    if (r->map == MAP_FAILED) {
+      close(r->fd);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* makes data block k (1 .. numblocks) current, -1 if it is bad */
+static int loadblock(struct x10cap_reader *r, uint64_t k)
+{
+  if (r->map != NULL) r->block = r->map + k * X10CAP_BLOCKSIZE;
+  else {
+    if (pread(r->fd, r->buf, X10CAP_BLOCKSIZE, k * X10CAP_BLOCKSIZE) !=
+	X10CAP_BLOCKSIZE)
+      return -1;
+    r->block = r->buf;
+  }
+  r->blockno = k;
+  r->used = get16(r->block + 4);
+  if (memcmp(r->block, blockmagic, sizeof(blockmagic)) != 0 ||
+      r->used < X10CAP_BLOCKHDR || r->used > X10CAP_BLOCKSIZE)
+    return -1;
+  return 0;
+}
+
+/* -1 for a record that runs past the block's used bytes */
+static int parserec(struct x10cap_reader *r, struct x10cap_rec *rec)
+{
+  const unsigned char *p = r->block + r->pos, *end = r->block + r->used;
+  uint64_t delta = 0;
+  int shift = 0;
+
+  do {
+    if (p >= end || shift > 63) return -1;
+    delta |= (uint64_t) (*p & 0x7F) << shift;
+    shift += 7;
+  } while (*p++ & 0x80);
+  if (end - p < 2) return -1;
+  r->t += delta;
+  rec->t = r->t;
+  rec->meta = *p++;
+  rec->byte = *p++;
+  r->pos = p - r->block;
+  return 0;
+}
+
+int x10cap_next(struct x10cap_reader *r, struct x10cap_rec *rec)
+{
+  size_t pos;
+
+  for(;;) {
+    if (r->block != NULL && r->pos < r->used)
+      return parserec(r, rec) < 0 ? -1 : 1;
+
+    /* a streaming reader picks up records added to a live capture */
+    if (r->map == NULL && r->block != NULL) {
+      pos = r->pos;
+      if (loadblock(r, r->blockno) < 0) return -1;
+      r->pos = pos;
+      if (r->pos < r->used) continue;
+    }
+    if (r->blockno >= r->numblocks) {
+      if (r->map != NULL) return 0;
+      r->numblocks = filesize(r->fd) / X10CAP_BLOCKSIZE - 1;
+      if (r->blockno >= r->numblocks) return 0;
+    }
+
+    if (loadblock(r, r->blockno + 1) < 0) return -1;
+    r->pos = X10CAP_BLOCKHDR;
+    r->t = get64(r->block + 8);
+  }
+}
+
+/* last time in data block k */
+static uint64_t blocktlast(struct x10cap_reader *r, uint64_t k)
+{
+  unsigned char hdr[X10CAP_BLOCKHDR];
+
+  if (r->map != NULL) return get64(r->map + k * X10CAP_BLOCKSIZE + 16);
+  if (pread(r->fd, hdr, sizeof(hdr), k * X10CAP_BLOCKSIZE) != sizeof(hdr))
+    return 0;
+  return get64(hdr + 16);
+}
+
+int x10cap_seek(struct x10cap_reader *r, uint64_t t)
+{
+  uint64_t lo = 1, hi = r->numblocks + 1, mid;
+  struct x10cap_rec rec;
+  size_t pos;
+  uint64_t prev;
+
+  /* first block that ends at or after t */
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (blocktlast(r, mid) < t) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo > r->numblocks) {
+    /* past the end: the next read finds nothing or new records */
+    if (r->numblocks == 0) {
+      r->block = NULL;
+      r->blockno = 0;
+      return 0;
+    }
+    lo = r->numblocks;
+  }
+
+  if (loadblock(r, lo) < 0) return -1;
+  r->pos = X10CAP_BLOCKHDR;
+  r->t = get64(r->block + 8);
+  while (r->pos < r->used) {
+    pos = r->pos;
+    prev = r->t;
+    if (parserec(r, &rec) < 0) return -1;
+    if (rec.t >= t) {
+      r->pos = pos;
+      r->t = prev;
+      break;
+    }
+  }
+  return 0;
+}
+
+void x10cap_close_reader(struct x10cap_reader *r)
+{
+  if (r->map != NULL) munmap((void *) r->map, (r->numblocks + 1) * X10CAP_BLOCKSIZE);
+  close(r->fd);
+}
@@ -0,0 +1,110 @@
+/*  x10cap.h  timestamped binary capture of X-10 serial traffic
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    a capture file is a header block followed by data blocks, all
+    X10CAP_BLOCKSIZE bytes.  every data block starts with a header
+    giving its first and last time and record count, followed by
+    records of
+        varint  microseconds since the previous record (the first record
+                of a block is relative to the block's first time)
+        byte    meta: port << 2 | protocol << 1 | direction
+        byte    the serial byte
+    the block headers sit at fixed offsets, so they are a sparse time
+    index: a seek is a binary search over them.  the file only grows
+    at its end, the last block is rewritten in place until it is full.
+    times are CLOCK_MONOTONIC microseconds, the header holds the offset
+    to wall clock time taken when the file was created.  a file carried
+    on by a later run, after a reboot too, has the new times moved by
+    the difference of the two offsets so they stay wall clock right
+*/
+
+#ifndef X10CAP_H
+#define X10CAP_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define X10CAP_BLOCKSIZE 4096
+#define X10CAP_BLOCKHDR 32
+#define X10CAP_MAXREC 12	/* 10 byte varint + meta + byte */
+#define X10CAP_FLUSHUS 1000000	/* x10cap_putbytes flush interval */
+
+#define X10CAP_RX 0		/* from the X-10 device */
+#define X10CAP_TX 1		/* to the X-10 device */
+#define X10CAP_CM11A 0
+#define X10CAP_MR26A 2
+#define X10CAP_MAXPORT 63
+
+#define x10cap_meta(port, proto, dir) (((port) << 2) | (proto) | (dir))
+#define x10cap_port(meta) ((meta) >> 2)
+#define x10cap_proto(meta) ((meta) & 2)
+#define x10cap_dir(meta) ((meta) & 1)
+
+struct x10cap_rec {
+  uint64_t t;		/* monotonic microseconds */
+  unsigned char meta;
+  unsigned char byte;
+};
+
+struct x10cap_writer {
+  int fd;
+  uint64_t blockno;		/* block being filled, 1 is the first */
+  size_t used;
+  unsigned int count;
+  uint64_t tfirst, tlast;
+  int64_t shift;		/* added to the times put, for a file carried on */
+  uint64_t lastflush;		/* by x10cap_putbytes, caller's time */
+  unsigned char block[X10CAP_BLOCKSIZE];
+};
+
+struct x10cap_reader {
+  int fd;
+  const unsigned char *map;	/* whole file when mapped, else NULL */
+  uint64_t numblocks, blockno;
+  int64_t anchor;		/* add to t for wall clock microseconds */
+  const unsigned char *block;
+  size_t pos, used;
+  uint64_t t;
+  unsigned char buf[X10CAP_BLOCKSIZE];
+};
+
+/* microseconds on the clock captures use */
+uint64_t x10cap_now(void);
+
+/* creates the file, or continues one that exists, -1 on errors and
+   for a file that isn't empty or a capture */
+int x10cap_create(struct x10cap_writer *w, const char *path);
+/* creates the file afresh with times that are wall clock microseconds
+   minus anchor, for records taken from other captures */
+int x10cap_create_anchored(struct x10cap_writer *w, const char *path,
+			   int64_t anchor);
+/* adds one record, writing out the block when it fills */
+int x10cap_put(struct x10cap_writer *w, uint64_t t, int meta,
+	       unsigned char byte);
+/* writes out the partly filled block */
+int x10cap_flush(struct x10cap_writer *w);
+int x10cap_close(struct x10cap_writer *w);
+
+/* for the tools that capture a port as they read it: n bytes read at t,
+   with the block written out every X10CAP_FLUSHUS so a crash loses at
+   most that much */
+int x10cap_putbytes(struct x10cap_writer *w, uint64_t t, int meta,
+		    const unsigned char *buf, int n);
+/* SIGINT and SIGTERM set x10cap_stopping and make a blocked read()
+   return, the read loop then closes the capture.  a handler can't
+   flush, it may have come in the middle of x10cap_put */
+extern volatile sig_atomic_t x10cap_stopping;
+void x10cap_catchstop(void);
+
+/* opens for streaming reads, or with usemap for mmap random access */
+int x10cap_open(struct x10cap_reader *r, const char *path, int usemap);
+/* next record in time order: 1, 0 at the end, -1 on a bad block */
+int x10cap_next(struct x10cap_reader *r, struct x10cap_rec *rec);
+/* positions before the first record at or after time t, -1 on a bad
+   block */
+int x10cap_seek(struct x10cap_reader *r, uint64_t t);
+void x10cap_close_reader(struct x10cap_reader *r);
+
+#endif
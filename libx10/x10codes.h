@@ -0,0 +1,77 @@
+/*  x10codes.h  X-10 code constants shared by the VS4T1 firmware and the
+                host tools in x10ref
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    only macros live here so the ATTiny2313 firmware can include it
+    without pulling in any code or RAM
+*/
+
+#ifndef X10CODES_H
+#define X10CODES_H
+
+/* house codes A-P and unit codes 1-16 use the same 4 bit code
+   X10_CODES lists them in order A-P or 1-16 */
+#define X10_CODES "\x06\x0E\x02\x0A\x01\x09\x05\x0D\x07\x0F\x03\x0B\x00\x08\x04\x0C"
+
+#define X10_UNIT1 0x06
+#define X10_UNIT2 0x0E
+#define X10_UNIT3 0x02
+#define X10_UNIT4 0x0A
+#define X10_UNIT5 0x01
+#define X10_UNIT6 0x09
+
+/* function codes, low nibble of a function byte */
+#define X10_ALL_UNITS_OFF 0x00
+#define X10_ALL_LIGHTS_ON 0x01
+#define X10_ON 0x02
+#define X10_OFF 0x03
+#define X10_DIM 0x04
+#define X10_BRIGHT 0x05
+#define X10_ALL_LIGHTS_OFF 0x06
+#define X10_EXTENDED_CODE 0x07
+#define X10_HAIL_REQUEST 0x08
+#define X10_HAIL_ACK 0x09
+#define X10_PRESET_DIM1 0x0A
+#define X10_PRESET_DIM2 0x0B
+#define X10_EXTENDED_DATA 0x0C
+#define X10_STATUS_ON 0x0D
+#define X10_STATUS_OFF 0x0E
+#define X10_STATUS_REQUEST 0x0F
+
+/* CM11A serial protocol, 4800 bps */
+#define CM11A_POLL 0x5A		/* CM11A has an upload waiting */
+#define CM11A_POLLACK 0xC3	/* PC answer to POLL */
+#define CM11A_TIMEREQ 0xA5	/* power fail, CM11A wants the time */
+#define CM11A_TIMESET 0x9B	/* PC time download header */
+#define CM11A_READY 0x55	/* CM11A done with a transmission */
+#define CM11A_ACK 0x00		/* PC checksum ok */
+#define CM11A_MAXUPLOAD 9	/* upload count byte is 1-9 */
+#define CM11A_HDR_ADDR 0x04	/* transmit header for an address */
+#define CM11A_HDR_FUNC 0x06	/* transmit header for a function */
+
+/* MR26A RF receiver frames, 9600 bps:  D5 AA hh uu AD */
+#define MR26A_SYNC1 0xD5
+#define MR26A_SYNC2 0xAA
+#define MR26A_END 0xAD
+#define MR26A_FRAMELEN 5
+
+/* the MR26A house code is the high nibble of hh, listed A-P */
+#define MR26A_HOUSES "\x06\x07\x04\x05\x08\x09\x0A\x0B\x0E\x0F\x0C\x0D\x00\x01\x02\x03"
+
+/* hh bit 2 selects units 9-16, uu bits 4, 3 and 6 are unit bits 0-2
+   and uu bit 5 turns the On into an Off */
+#define MR26A_UNIT9 0x04
+#define MR26A_OFF 0x20
+#define MR26A_UNIT1_ON 0x00
+#define MR26A_UNIT2_ON 0x10
+#define MR26A_UNIT3_ON 0x08
+#define MR26A_UNIT4_ON 0x18
+#define MR26A_UNIT5_ON 0x40
+#define MR26A_UNIT6_ON 0x50
+/* uu for units 1-8 On in order */
+#define MR26A_UNITS "\x00\x10\x08\x18\x40\x50\x48\x58"
+#define MR26A_BRIGHT 0x88
+#define MR26A_DIM 0x98
+
+#endif
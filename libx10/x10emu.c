@@ -0,0 +1,526 @@
+/*  x10emu.c  emulated X-10 receivers as load generators
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    each emulator moves forward with act(), which does everything that
+    is due at one time and may put bytes on the line.  peek runs a copy
+    forward to the first byte, so looking ahead commits nothing and a
+    byte from the PC in the meantime can still change what comes next.
+    the MR26A has nothing coming back, so it simply runs forward
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "x10emu.h"
+
+enum { CM_IDLE, CM_POLLING, CM_TIMEREQ, CM_CHECKSUM, CM_XMIT };
+
+#define CM11A_TIMEREQUS 1000000	/* time request repeat */
+#define CM11A_ACKWAITUS 1000000	/* wait for the PC's 0x00 */
+
+void x10emu_defaults(struct x10emu_load *load)
+{
+  memset(load, 0, sizeof(*load));
+  load->rate = 1;
+  load->burst = 1;
+  load->burstgap = 50000;
+  load->houses = 1;
+  load->units = 16;
+  load->acktimeout = 1000000;
+  load->frametime = CM11A_FRAMEUS;
+  load->seed = 1;
+  load->remotes = 1;
+  load->repeats = 5;
+  load->repeatgap = MR26A_REPEATUS;
+  load->jitter = 5000;
+}
+
+void x10emu_record(struct x10emu_hist *h, uint64_t us)
+{
+  int b = 0;
+
+  h->count++;
+  h->sum += us;
+  if (us > h->max) h->max = us;
+  while (b < X10EMU_HIST - 1 && (us >> (b + 1)) > 0) ++b;
+  h->bucket[b]++;
+}
+
+/* mean, max and the bucket holding the median and 99th percentile */
+void x10emu_print_hist(FILE *f, const char *name, const struct x10emu_hist *h)
+{
+  uint64_t n50 = 0, n99 = 0, seen = 0;
+  int b;
+
+  if (h->count == 0) {
+    fprintf(f, "%s: none\n", name);
+    return;
+  }
+  for (b = 0; b < X10EMU_HIST; ++b) {
+    seen += h->bucket[b];
+    if (n50 == 0 && seen * 2 >= h->count) n50 = (uint64_t) 2 << b;
+    if (n99 == 0 && seen * 100 >= h->count * 99) n99 = (uint64_t) 2 << b;
+  }
+  fprintf(f, "%s: %lu, mean %.3f ms, max %.3f ms, p50 < %.3f ms, p99 < %.3f ms\n",
+	  name, (unsigned long) h->count, h->sum / 1e3 / h->count, h->max / 1e3,
+	  n50 / 1e3, n99 / 1e3);
+}
+
+/* xorshift64*, so a seed gives the same traffic every run */
+static uint64_t rnd(uint64_t *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+static double rndf(uint64_t *state)
+{
+  return (rnd(state) >> 11) / 9007199254740992.0;
+}
+
+/* t plus an exponential gap for rate per second, never for no rate */
+static uint64_t expgap(uint64_t *state, uint64_t t, double rate)
+{
+  if (rate <= 0 || t == X10EMU_NEVER) return X10EMU_NEVER;
+  return t + (uint64_t) (-log(1 - rndf(state)) / rate * 1e6) + 1;
+}
+
+/* a random house code from the mask */
+static int rndhouse(uint64_t *state, unsigned int houses)
+{
+  int i, n = 0, pick;
+
+  for (i = 0; i < 16; ++i) n += (houses >> i) & 1;
+  if (n == 0) return x10_code[0];
+  pick = rnd(state) % n;
+  for (i = 0; i < 16; ++i)
+    if (((houses >> i) & 1) && pick-- == 0) break;
+  return x10_code[i];
+}
+
+/* schedules the event after the one at nextgen */
+static void nextevent(uint64_t *rng, const struct x10emu_load *load,
+		      uint64_t *nextgen, int *burstleft, uint64_t events)
+{
+  if (load->maxevents > 0 && events >= (uint64_t) load->maxevents)
+    *nextgen = X10EMU_NEVER;
+  else if (--*burstleft > 0) *nextgen += load->burstgap;
+  else {
+    *burstleft = load->burst;
+    *nextgen = expgap(rng, *nextgen, load->rate);
+  }
+}
+
+/* CM11A */
+
+void cm11a_emu_init(struct cm11a_emu *e, const struct x10emu_load *load,
+		    uint64_t now)
+{
+  memset(e, 0, sizeof(*e));
+  e->load = *load;
+  e->rng = load->seed ? load->seed : 1;
+  e->now = e->linefree = now;
+  e->burstleft = load->burst > 0 ? load->burst : 1;
+  e->nextgen = expgap(&e->rng, now, load->rate);
+  e->nextpowerfail = load->powerfail ? now + load->powerfail : X10EMU_NEVER;
+  e->state = CM_IDLE;
+}
+
+static void cm_emit(struct cm11a_emu *e, unsigned char byte)
+{
+  uint64_t t = e->now > e->linefree ? e->now : e->linefree;
+
+  if (e->outlen >= (int) sizeof(e->out)) return;
+  e->out[e->outlen] = byte;
+  e->outtime[e->outlen++] = t;
+  e->linefree = t + CM11A_BYTEUS;
+}
+
+static void cm_queue(struct cm11a_emu *e, unsigned char code, int func)
+{
+  if (e->qlen >= X10EMU_MAXQUEUE) return;
+  e->qcode[e->qlen] = code;
+  e->qfunc[e->qlen] = func;
+  e->qtime[e->qlen++] = e->nextgen;
+}
+
+/* an address and function, with a data byte for dim and bright */
+static void cm_generate(struct cm11a_emu *e)
+{
+  static const unsigned char funcs[] = {X10_ON, X10_ON, X10_ON, X10_ON,
+					X10_OFF, X10_OFF, X10_OFF, X10_OFF,
+					X10_DIM, X10_BRIGHT};
+  int house = rndhouse(&e->rng, e->load.houses);
+  int unit = x10_code[rnd(&e->rng) % (e->load.units > 0 ? e->load.units : 16)];
+  int func = funcs[rnd(&e->rng) % sizeof(funcs)];
+
+  if (e->qlen + 3 <= X10EMU_MAXQUEUE) {
+    cm_queue(e, (house << 4) | unit, 0);
+    cm_queue(e, (house << 4) | func, 1);
+    if (x10_datacount[func] > 0) cm_queue(e, rnd(&e->rng) % 211, 0);
+  }
+  e->stats.events++;
+  nextevent(&e->rng, &e->load, &e->nextgen, &e->burstleft, e->stats.events);
+}
+
+static uint64_t cm_nextaction(const struct cm11a_emu *e)
+{
+  uint64_t t = e->nextgen;
+
+  if (e->state == CM_IDLE) {
+    if (e->nextpowerfail < t)
+      t = e->nextpowerfail > e->now ? e->nextpowerfail : e->now;
+    if (e->qlen > 0) {
+      if (e->linefree < t) t = e->linefree > e->now ? e->linefree : e->now;
+    }
+  } else if (e->deadline < t) t = e->deadline;
+  return t;
+}
+
+static void cm_act(struct cm11a_emu *e, uint64_t t)
+{
+  if (t > e->now) e->now = t;
+  while (e->nextgen <= e->now) cm_generate(e);
+
+  switch (e->state) {
+  case CM_IDLE:
+    if (e->nextpowerfail <= e->now) {
+      e->nextpowerfail += e->load.powerfail;
+      e->state = CM_TIMEREQ;
+      cm_emit(e, CM11A_TIMEREQ);
+      e->deadline = e->linefree + CM11A_TIMEREQUS;
+      e->stats.timereqs++;
+    } else if (e->qlen > 0 && e->linefree <= e->now) {
+      e->state = CM_POLLING;
+      cm_emit(e, CM11A_POLL);
+      e->polltime = e->outtime[e->outlen - 1];
+      e->deadline = e->linefree + e->load.acktimeout;
+      e->stats.polls++;
+    }
+    break;
+  case CM_POLLING:
+    if (e->deadline <= e->now) {
+      cm_emit(e, CM11A_POLL);
+      e->deadline = e->linefree + e->load.acktimeout;
+      e->stats.pollretries++;
+    }
+    break;
+  case CM_TIMEREQ:
+    if (e->deadline <= e->now) {
+      cm_emit(e, CM11A_TIMEREQ);
+      e->deadline = e->linefree + CM11A_TIMEREQUS;
+    }
+    break;
+  case CM_CHECKSUM:
+    if (e->deadline <= e->now) e->state = CM_IDLE;
+    break;
+  case CM_XMIT:
+    if (e->deadline <= e->now) {
+      cm_emit(e, CM11A_READY);
+      e->state = CM_IDLE;
+    }
+    break;
+  }
+}
+
+static void cm_advance(struct cm11a_emu *e, uint64_t t)
+{
+  uint64_t a;
+
+  while ((a = cm_nextaction(e)) <= t) cm_act(e, a);
+  if (t > e->now) e->now = t;
+}
+
+int cm11a_emu_peek(struct cm11a_emu *e, uint64_t *t, unsigned char *byte)
+{
+  struct cm11a_emu ahead;
+  const struct cm11a_emu *from = e;
+  uint64_t a;
+
+  if (e->outlen == 0) {
+    ahead = *e;
+    while (ahead.outlen == 0) {
+      if ((a = cm_nextaction(&ahead)) == X10EMU_NEVER) return 0;
+      cm_act(&ahead, a);
+    }
+    from = &ahead;
+  }
+  *t = from->outtime[0];
+  *byte = from->out[0];
+  return 1;
+}
+
+void cm11a_emu_take(struct cm11a_emu *e)
+{
+  uint64_t a;
+
+  while (e->outlen == 0) {
+    if ((a = cm_nextaction(e)) == X10EMU_NEVER) return;
+    cm_act(e, a);
+  }
+  if (e->outtime[0] > e->now) e->now = e->outtime[0];
+  memmove(e->out, e->out + 1, --e->outlen);
+  memmove(e->outtime, e->outtime + 1, e->outlen * sizeof(e->outtime[0]));
+}
+
+/* answers the 0xC3 with up to 8 queued codes, not splitting off the
+   data of a dim or bright */
+static void cm_upload(struct cm11a_emu *e)
+{
+  unsigned char up[10];
+  int n = 0, i, count;
+
+  while (n < e->qlen && n < CM11A_MAXUPLOAD - 1) {
+    if (e->qfunc[n] && x10_datacount[e->qcode[n] & 0x0F] > 0 &&
+	n + 1 >= CM11A_MAXUPLOAD - 1)
+      break;
+    ++n;
+  }
+  count = cm11a_encode_upload(up, e->qcode, 0, n);
+  for (i = 0; i < n; ++i) up[1] |= e->qfunc[i] << i;
+  x10emu_record(&e->stats.acklatency, e->now - e->polltime);
+
+  if (rndf(&e->rng) < e->load.badcountrate) {
+    up[0] = CM11A_MAXUPLOAD + 1 + rnd(&e->rng) % 246;
+    e->stats.badcounts++;
+  }
+  for (i = 0; i < count; ++i) {
+    if (rndf(&e->rng) < e->load.droprate) {
+      e->stats.drops++;
+      continue;
+    }
+    cm_emit(e, up[i]);
+    if (i >= 2 && e->qfunc[i - 2])
+      x10emu_record(&e->stats.eventlatency, e->linefree - e->qtime[i - 2]);
+  }
+
+  e->qlen -= n;
+  memmove(e->qcode, e->qcode + n, e->qlen);
+  memmove(e->qfunc, e->qfunc + n, e->qlen);
+  memmove(e->qtime, e->qtime + n, e->qlen * sizeof(e->qtime[0]));
+  e->stats.uploads++;
+  e->state = CM_IDLE;
+}
+
+/* a time download or a transmit header and code is complete */
+static void cm_download(struct cm11a_emu *e)
+{
+  int i, sum = 0;
+
+  if (e->host[0] == CM11A_TIMESET) {
+    for (i = 1; i < e->hostlen; ++i) sum += e->host[i];
+    e->xmitcodes = 0;
+    e->stats.timesets++;
+  } else {
+    sum = cm11a_checksum(e->host);
+    e->xmitcodes = 1;
+    if (rndf(&e->rng) < e->load.badsumrate) {
+      sum = ~sum;
+      e->stats.badsums++;
+    }
+  }
+  cm_emit(e, sum & 0xFF);
+  e->state = CM_CHECKSUM;
+  e->deadline = e->linefree + CM11A_ACKWAITUS;
+  e->hostwant = 0;
+}
+
+void cm11a_emu_host(struct cm11a_emu *e, uint64_t t, unsigned char byte)
+{
+  cm_advance(e, t);
+
+  if (e->hostwant > 0) {
+    e->host[e->hostlen++] = byte;
+    if (e->hostlen == e->hostwant) cm_download(e);
+    return;
+  }
+
+  if (byte == CM11A_POLLACK) {
+    if (e->state == CM_POLLING) cm_upload(e);
+  }
+  else if (byte == CM11A_TIMESET) {
+    e->host[0] = byte;
+    e->hostlen = 1;
+    e->hostwant = 7;
+  }
+  else if ((byte & 0x07) == CM11A_HDR_ADDR || (byte & 0x07) == CM11A_HDR_FUNC) {
+    /* a transmit, also a resend after a bad checksum.  while it polls
+       the CM11A only listens for 0xC3 */
+    if (e->state == CM_CHECKSUM) e->stats.resends++;
+    if (e->state == CM_IDLE || e->state == CM_CHECKSUM) {
+      e->host[0] = byte;
+      e->hostlen = 1;
+      e->hostwant = 2;
+    }
+  }
+  else if (byte == CM11A_ACK && e->state == CM_CHECKSUM) {
+    if (e->xmitcodes > 0) {
+      e->state = CM_XMIT;
+      e->deadline = e->now + e->xmitcodes * e->load.frametime;
+      e->stats.commands++;
+    } else {
+      cm_emit(e, CM11A_READY);
+      e->state = CM_IDLE;
+    }
+  }
+}
+
+int cm11a_emu_done(const struct cm11a_emu *e)
+{
+  return e->qlen == 0 && e->outlen == 0 && e->state == CM_IDLE &&
+    e->nextgen == X10EMU_NEVER;
+}
+
+/* MR26A */
+
+void mr26a_emu_init(struct mr26a_emu *e, const struct x10emu_load *load,
+		    uint64_t now)
+{
+  int i;
+
+  memset(e, 0, sizeof(*e));
+  e->load = *load;
+  e->rng = load->seed ? load->seed : 1;
+  e->now = e->linefree = now;
+  e->nremotes = load->remotes < 1 ? 1 : load->remotes > MR26A_MAXREMOTES ?
+    MR26A_MAXREMOTES : load->remotes;
+  /* the remotes share the rate between them */
+  e->load.rate = load->rate / e->nremotes;
+  if (e->load.jitter > e->load.repeatgap / 2) e->load.jitter = e->load.repeatgap / 2;
+  for (i = 0; i < e->nremotes; ++i) {
+    e->remote[i].burstleft = load->burst > 0 ? load->burst : 1;
+    e->remote[i].nextgen = expgap(&e->rng, now, e->load.rate);
+    e->remote[i].nextframe = X10EMU_NEVER;
+  }
+}
+
+/* a remote sends on and off for units 1-16 and dim and bright */
+static void mr_press(struct mr26a_emu *e, struct mr26a_remote *r)
+{
+  static const unsigned char funcs[] = {X10_ON, X10_ON, X10_ON, X10_ON,
+					X10_OFF, X10_OFF, X10_OFF, X10_OFF,
+					X10_DIM, X10_BRIGHT};
+
+  if (e->load.maxevents > 0 && e->stats.events >= (uint64_t) e->load.maxevents) {
+    r->nextgen = X10EMU_NEVER;
+    return;
+  }
+  r->cmd.house = rndhouse(&e->rng, e->load.houses);
+  r->cmd.unit = x10_code[rnd(&e->rng) % (e->load.units > 0 ? e->load.units : 16)];
+  r->cmd.func = funcs[rnd(&e->rng) % sizeof(funcs)];
+  mr26a_encode(r->frame, &r->cmd);
+  r->repeatsleft = e->load.repeats > 0 ? e->load.repeats : 1;
+  r->heard = 0;
+  /* the first frame is heard once it has gone over the air */
+  r->nextframe = r->nextgen + e->load.repeatgap;
+  e->stats.events++;
+  nextevent(&e->rng, &e->load, &r->nextgen, &r->burstleft, e->stats.events);
+}
+
+/* the MR26A passes on a frame it heard, maybe damaged on the way */
+static void mr_frame(struct mr26a_emu *e, struct mr26a_remote *r)
+{
+  uint64_t t;
+  int i;
+  unsigned char byte;
+
+  e->stats.frames++;
+  if (rndf(&e->rng) < e->load.missrate) e->stats.misses++;
+  else if (e->outlen + MR26A_FRAMELEN <= (int) sizeof(e->out))
+    for (i = 0; i < MR26A_FRAMELEN; ++i) {
+      byte = r->frame[i];
+      if (rndf(&e->rng) < e->load.droprate) {
+	e->stats.drops++;
+	continue;
+      }
+      if (rndf(&e->rng) < e->load.corruptrate) {
+	byte ^= 1 << (rnd(&e->rng) & 7);
+	e->stats.corrupts++;
+      }
+      t = e->now > e->linefree ? e->now : e->linefree;
+      e->out[e->outlen] = byte;
+      e->first[e->outlen] = !r->heard;
+      e->outcmd[e->outlen] = r->cmd;
+      e->outtime[e->outlen++] = t;
+      e->linefree = t + MR26A_BYTEUS;
+      r->heard = 1;
+    }
+
+  if (--r->repeatsleft > 0) {
+    r->nextframe += e->load.repeatgap - e->load.jitter
+      + rnd(&e->rng) % (2 * e->load.jitter + 1);
+  } else {
+    /* no new press until the last repeat is over */
+    if (r->nextgen < r->nextframe && r->nextgen != X10EMU_NEVER)
+      r->nextgen = r->nextframe;
+    r->nextframe = X10EMU_NEVER;
+  }
+}
+
+/* the remote and time of the next thing to happen */
+static struct mr26a_remote *mr_next(struct mr26a_emu *e, uint64_t *t)
+{
+  struct mr26a_remote *r, *next = NULL;
+  int i;
+
+  *t = X10EMU_NEVER;
+  for (i = 0; i < e->nremotes; ++i) {
+    r = &e->remote[i];
+    if (r->nextframe != X10EMU_NEVER) {
+      if (r->nextframe < *t) *t = r->nextframe, next = r;
+    } else if (r->nextgen < *t) *t = r->nextgen, next = r;
+  }
+  return next;
+}
+
+static int mr_fill(struct mr26a_emu *e)
+{
+  struct mr26a_remote *r;
+  uint64_t t;
+
+  while (e->outlen == 0) {
+    if ((r = mr_next(e, &t)) == NULL) return 0;
+    if (t > e->now) e->now = t;
+    if (r->nextframe != X10EMU_NEVER) mr_frame(e, r);
+    else mr_press(e, r);
+  }
+  return 1;
+}
+
+int mr26a_emu_peek(struct mr26a_emu *e, uint64_t *t, unsigned char *byte)
+{
+  if (!mr_fill(e)) return 0;
+  *t = e->outtime[0];
+  *byte = e->out[0];
+  return 1;
+}
+
+int mr26a_emu_take(struct mr26a_emu *e, struct x10_cmd *cmd)
+{
+  int first;
+
+  if (!mr_fill(e)) return 0;
+  first = e->first[0];
+  if (first && cmd != NULL) *cmd = e->outcmd[0];
+  e->stats.bytes++;
+  --e->outlen;
+  memmove(e->out, e->out + 1, e->outlen);
+  memmove(e->first, e->first + 1, e->outlen);
+  memmove(e->outtime, e->outtime + 1, e->outlen * sizeof(e->outtime[0]));
+  memmove(e->outcmd, e->outcmd + 1, e->outlen * sizeof(e->outcmd[0]));
+  return first;
+}
+
+int mr26a_emu_done(const struct mr26a_emu *e)
+{
+  int i;
+
+  if (e->outlen > 0) return 0;
+  for (i = 0; i < e->nremotes; ++i)
+    if (e->remote[i].nextgen != X10EMU_NEVER
+	|| e->remote[i].nextframe != X10EMU_NEVER) return 0;
+  return 1;
+}
@@ -0,0 +1,132 @@
+/*  x10emu.h  emulated X-10 receivers as load generators
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    an emulator is a byte source in virtual time, in microseconds:
+    peek gives the next byte it sends and when, assuming nothing comes
+    from the PC before then, take commits it, and host hands it a byte
+    from the PC.  the same emulator drives a pty (x10ref/cm11aemu) or
+    the host build of the firmware (avrsim rx callbacks) directly
+*/
+
+#ifndef X10EMU_H
+#define X10EMU_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "x10.h"
+
+#define X10EMU_MAXQUEUE 64	/* codes waiting for an upload */
+#define X10EMU_HIST 32		/* log2 microsecond latency buckets */
+#define X10EMU_NEVER UINT64_MAX
+
+#define CM11A_BYTEUS 2083	/* 10 bits at 4800 bps */
+#define CM11A_FRAMEUS 416667	/* one code on the powerline, 25 cycles at 60 Hz */
+#define MR26A_BYTEUS 1042	/* 10 bits at 9600 bps */
+#define MR26A_REPEATUS 75000	/* RF frame and gap, from the start of one to the next */
+#define MR26A_MAXREMOTES 16
+
+/* what to generate and what to get wrong */
+struct x10emu_load {
+  double rate;		/* bursts per second, exponential gaps */
+  int burst;		/* events per burst */
+  uint64_t burstgap;	/* between events of a burst */
+  unsigned int houses;	/* bit per house index A-P to pick from */
+  int units;		/* units 1-units are picked from */
+  uint64_t acktimeout;	/* CM11A poll retry interval */
+  uint64_t powerfail;	/* CM11A time request interval, 0 for none */
+  uint64_t frametime;	/* CM11A powerline time per code transmitted */
+  double droprate;	/* chance a byte of an upload goes missing */
+  double badcountrate;	/* chance an upload count byte is over 9 */
+  double badsumrate;	/* chance a transmit checksum is wrong */
+  int remotes;		/* MR26A remotes pressed independently */
+  int repeats;		/* MR26A frames per press */
+  uint64_t repeatgap;	/* MR26A start of one frame to the next */
+  uint64_t jitter;	/* MR26A repeatgap varies up to this either way */
+  double missrate;	/* chance the MR26A doesn't hear a frame */
+  double corruptrate;	/* chance an MR26A byte has a bit flipped */
+  uint64_t seed;
+  long maxevents;	/* stop generating after this many, 0 no limit */
+};
+
+/* fills in the defaults: 1 burst/s of 1 event, house A units 1-16,
+   one MR26A remote sending 5 repeats */
+void x10emu_defaults(struct x10emu_load *load);
+
+struct x10emu_hist {
+  uint64_t count, sum, max;
+  uint64_t bucket[X10EMU_HIST];
+};
+
+void x10emu_record(struct x10emu_hist *h, uint64_t us);
+void x10emu_print_hist(FILE *f, const char *name, const struct x10emu_hist *h);
+
+struct cm11a_emu_stats {
+  uint64_t events, uploads, polls, pollretries, timereqs, timesets;
+  uint64_t drops, badcounts, commands, badsums, resends;
+  struct x10emu_hist acklatency;	/* poll sent to 0xC3 back */
+  struct x10emu_hist eventlatency;	/* event to the end of its upload */
+};
+
+struct cm11a_emu {
+  struct x10emu_load load;
+  uint64_t rng, now, nextgen, linefree, deadline, nextpowerfail;
+  int burstleft, state;
+  /* generated codes waiting, with the time each event happened */
+  unsigned char qcode[X10EMU_MAXQUEUE], qfunc[X10EMU_MAXQUEUE];
+  uint64_t qtime[X10EMU_MAXQUEUE];
+  int qlen;
+  /* bytes committed to the line */
+  unsigned char out[16];
+  uint64_t outtime[16];
+  int outlen;
+  uint64_t polltime;
+  /* bytes from the PC being collected */
+  unsigned char host[8];
+  int hostlen, hostwant, xmitcodes;
+  struct cm11a_emu_stats stats;
+};
+
+void cm11a_emu_init(struct cm11a_emu *e, const struct x10emu_load *load,
+		    uint64_t now);
+int cm11a_emu_peek(struct cm11a_emu *e, uint64_t *t, unsigned char *byte);
+void cm11a_emu_take(struct cm11a_emu *e);
+void cm11a_emu_host(struct cm11a_emu *e, uint64_t t, unsigned char byte);
+/* nothing queued or on the line and no more events coming */
+int cm11a_emu_done(const struct cm11a_emu *e);
+
+struct mr26a_emu_stats {
+  uint64_t events, frames, bytes, misses, drops, corrupts;
+};
+
+/* one remote's press in flight */
+struct mr26a_remote {
+  uint64_t nextgen, nextframe;
+  int burstleft, repeatsleft, heard;
+  unsigned char frame[MR26A_FRAMELEN];
+  struct x10_cmd cmd;
+};
+
+/* the MR26A only talks, so peek runs the emulator itself forward */
+struct mr26a_emu {
+  struct x10emu_load load;
+  uint64_t rng, now, linefree;
+  int nremotes;
+  struct mr26a_remote remote[MR26A_MAXREMOTES];
+  /* bytes committed to the line, first marks the first byte of a press */
+  unsigned char out[64], first[64];
+  uint64_t outtime[64];
+  struct x10_cmd outcmd[64];
+  int outlen;
+  struct mr26a_emu_stats stats;
+};
+
+void mr26a_emu_init(struct mr26a_emu *e, const struct x10emu_load *load,
+		    uint64_t now);
+int mr26a_emu_peek(struct mr26a_emu *e, uint64_t *t, unsigned char *byte);
+/* returns 1 with the command pressed when the byte taken is the first
+   one on the line for that press, cmd may be NULL */
+int mr26a_emu_take(struct mr26a_emu *e, struct x10_cmd *cmd);
+int mr26a_emu_done(const struct mr26a_emu *e);
+
+#endif
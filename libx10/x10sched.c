@@ -0,0 +1,113 @@
+/*  x10sched.c  batches X-10 commands for the CM11A transmit queue
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+*/
+
+#include <string.h>
+#include "x10sched.h"
+
+void x10sched_init(struct x10sched *s, struct cm11a_port *port, uint64_t budget)
+{
+  memset(s, 0, sizeof(*s));
+  s->port = port;
+  s->budget = budget;
+}
+
+int x10sched_add(struct x10sched *s, const struct x10_cmd *cmd, int dims, uint64_t now)
+{
+  struct x10sched_cmd *c;
+
+  if (s->npend == X10SCHED_MAX) return -1;
+  c = &s->pend[s->npend++];
+  c->cmd = *cmd;
+  c->dims = dims < 0 ? 0 : dims > 22 ? 22 : dims;
+  c->queued = now;
+  return 0;
+}
+
+void x10sched_heard(struct x10sched *s)
+{
+  memset(s->addressed, 0, sizeof(s->addressed));
+}
+
+#define samegroup(a, b) ((a)->cmd.house == (b)->cmd.house \
+			 && (a)->cmd.func == (b)->cmd.func && (a)->dims == (b)->dims \
+			 && ((a)->cmd.unit == X10_NOUNIT) == ((b)->cmd.unit == X10_NOUNIT))
+
+void x10sched_run(struct x10sched *s, uint64_t now)
+{
+  struct x10sched_batch b;
+  struct x10sched_cmd *c, *first = &s->pend[0];
+  unsigned char pair[2], take[X10SCHED_MAX];
+  unsigned int passed = 0;	/* units of commands left behind */
+  int i, n, u, jumping = 1;
+
+  if (cm11a_pending(s->port) > 0) return;
+
+  /* the last batch is done, if a code of it may not have gone the
+     units it left addressed aren't known */
+  if (s->port->txstats.timeouts + s->port->txstats.failed != s->troubles) {
+    s->troubles = s->port->txstats.timeouts + s->port->txstats.failed;
+    x10sched_heard(s);
+  }
+  for (i = 0; i < s->nflight; ++i) {
+    s->stats.latsum += now - s->flight[i];
+    if (now - s->flight[i] > s->stats.latmax) s->stats.latmax = now - s->flight[i];
+  }
+  s->nflight = 0;
+  if (s->npend == 0) return;
+
+  memset(&b, 0, sizeof(b));
+  b.house = first->cmd.house;
+  b.func = first->cmd.func;
+  b.dims = first->dims;
+  for (i = 0; i < s->npend; ++i) {
+    c = &s->pend[i];
+    u = c->cmd.unit == X10_NOUNIT ? -1 : x10_index[c->cmd.unit];
+    take[i] = 0;
+    /* a command can't go before one left behind for the same unit, a
+       house function before any of its house, and a unit dims once a
+       batch, dim and bright add up where on and off don't */
+    if (samegroup(c, first) && (i == 0 || jumping)
+	&& !(u >= 0 ? (passed >> u) & 1 : passed != 0)
+	&& !(u >= 0 && ((b.units >> u) & 1) && (b.func == X10_DIM || b.func == X10_BRIGHT))) {
+      take[i] = 1;
+      b.commands++;
+      if (u >= 0) b.units |= 1 << u;
+      continue;
+    }
+    if (c->cmd.house == b.house) passed |= u < 0 ? 0xFFFF : 1 << u;
+    /* nothing more jumps a command that has waited its budget */
+    if (now - c->queued >= s->budget) jumping = 0;
+  }
+
+  /* addresses, unless the house is still addressed with the same units */
+  b.frames = 1;
+  if (b.units != 0 && s->addressed[b.house] != b.units) {
+    for (u = 0; u < 16; ++u)
+      if ((b.units >> u) & 1) {
+	cm11a_encode_addr(pair, b.house, x10_code[u]);
+	cm11a_queue(s->port, pair);
+	b.frames++;
+      }
+  }
+  cm11a_encode_func(pair, b.house, b.func, b.dims);
+  cm11a_queue(s->port, pair);
+  s->addressed[b.house] = b.units;
+
+  /* a pair per command with a unit, a function for those without */
+  b.saved = -b.frames;
+  for (i = 0; i < s->npend; ++i)
+    if (take[i]) b.saved += s->pend[i].cmd.unit == X10_NOUNIT ? 1 : 2;
+
+  for (i = n = 0; i < s->npend; ++i)
+    if (!take[i]) s->pend[n++] = s->pend[i];
+    else s->flight[s->nflight++] = s->pend[i].queued;
+  s->npend = n;
+
+  s->stats.batches++;
+  s->stats.commands += b.commands;
+  s->stats.frames += b.frames;
+  s->stats.saved += b.saved;
+  if (s->batched) s->batched(s, &b);
+}
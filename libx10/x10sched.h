@@ -0,0 +1,69 @@
+/*  x10sched.h  batches X-10 commands for the CM11A transmit queue
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    every code takes close to half a second on the powerline, and
+    "A1 On, A2 On, A3 On" needs 6 of them where "A1 A2 A3 On" needs 4.
+    commands wait here and each time the CM11A queue runs empty the
+    oldest one goes with every later command for the same house,
+    function and dim steps, as one set of addresses and one function.
+    a later command only jumps ahead of others younger than the budget,
+    and never ahead of another command for its own unit.  the units a
+    house was last left addressed with are remembered, so "A1 A2 Off"
+    after "A1 A2 On" is a function alone, until x10sched_heard says
+    something else was on the line or a code of the batch timed out or
+    failed
+*/
+
+#ifndef X10SCHED_H
+#define X10SCHED_H
+
+#include <stdint.h>
+#include "cm11a.h"
+
+#define X10SCHED_MAX 256
+#define X10SCHED_FRAMEUS 416667	/* one code on the powerline at 60 Hz */
+
+struct x10sched_cmd {
+  struct x10_cmd cmd;
+  unsigned char dims;
+  uint64_t queued;
+};
+
+struct x10sched_batch {
+  int house, func, dims;	/* codes */
+  unsigned int units;		/* bit per unit index */
+  int commands, frames;
+  int saved;			/* frames against a pair per command */
+};
+
+struct x10sched_stats {
+  uint64_t batches, commands, frames, saved;
+  uint64_t latsum, latmax;	/* added to the last code's 0x55 */
+};
+
+struct x10sched {
+  struct cm11a_port *port;
+  uint64_t budget;		/* microseconds a command may be passed */
+  struct x10sched_cmd pend[X10SCHED_MAX];
+  int npend;
+  uint64_t flight[X10SCHED_MAX];	/* when the batch on the line was added */
+  int nflight;
+  unsigned int addressed[16];	/* by house code, 0 for unknown */
+  uint64_t troubles;		/* port timeouts and failures seen so far */
+  /* called with each batch as it is queued, may be NULL */
+  void (*batched)(struct x10sched *s, const struct x10sched_batch *b);
+  struct x10sched_stats stats;
+};
+
+void x10sched_init(struct x10sched *s, struct cm11a_port *port, uint64_t budget);
+/* -1 when full */
+int x10sched_add(struct x10sched *s, const struct x10_cmd *cmd, int dims, uint64_t now);
+/* queues the next batch if the CM11A queue is empty, call it after
+   every cm11a_read and cm11a_tick */
+void x10sched_run(struct x10sched *s, uint64_t now);
+/* other traffic on the line, forget what is addressed */
+void x10sched_heard(struct x10sched *s);
+#define x10sched_pending(s) ((s)->npend)
+
+#endif
@@ -0,0 +1,117 @@
+/*  x10state.c  what every X-10 unit was last told to do
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+*/
+
+#include <string.h>
+#include "x10state.h"
+
+void x10_state_init(struct x10_state *st)
+{
+  int h, u;
+
+  memset(st, 0, sizeof(*st));
+  for (h = 0; h < 16; ++h)
+    for (u = 0; u < 16; ++u) st->unit[h][u].level = 100;
+  st->dimhouse = -1;
+}
+
+static int setunit(struct x10_state *st, int h, int u, int on, int level,
+		   int func, uint64_t t)
+{
+  struct x10_unitstate *s = &st->unit[h][u];
+
+  s->func = func;
+  if (s->on == on && s->level == level) return 0;
+  s->on = on;
+  s->level = level;
+  s->changed = t;
+  st->dirty[h] |= 1 << u;
+  return 1;
+}
+
+/* func on the units in mask of house h, dims in percent for dim/bright */
+static int applyfunc(struct x10_state *st, int h, unsigned int mask,
+		     int func, int dims, uint64_t t)
+{
+  struct x10_unitstate *s;
+  int u, level, n = 0;
+
+  for (u = 0; u < 16; ++u) {
+    if (!((mask >> u) & 1)) continue;
+    s = &st->unit[h][u];
+    switch (func) {
+    case X10_ON:
+    case X10_ALL_LIGHTS_ON:
+    case X10_STATUS_ON:
+      n += setunit(st, h, u, 1, s->level, func, t);
+      break;
+    case X10_OFF:
+    case X10_ALL_UNITS_OFF:
+    case X10_ALL_LIGHTS_OFF:
+    case X10_STATUS_OFF:
+      n += setunit(st, h, u, 0, s->level, func, t);
+      break;
+    case X10_DIM:
+      /* dimming an off lamp starts from full */
+      level = (s->on ? s->level : 100) - dims;
+      n += setunit(st, h, u, 1, level < 0 ? 0 : level, func, t);
+      break;
+    case X10_BRIGHT:
+      level = (s->on ? s->level : 0) + dims;
+      n += setunit(st, h, u, 1, level > 100 ? 100 : level, func, t);
+      break;
+    default:
+      s->func = func;
+      break;
+    }
+  }
+  return n;
+}
+
+int x10_state_apply(struct x10_state *st, const struct x10_rec *rec, uint64_t t)
+{
+  int h, func, n;
+
+  if (rec->type == 'D') {
+    /* the first data byte after dim or bright is the amount */
+    if (st->dimhouse < 0) return 0;
+    h = st->dimhouse;
+    st->dimhouse = -1;
+    return applyfunc(st, h, st->addressed[h], st->dimfunc,
+		     (rec->value * 100 + X10_DIMSTEPS / 2) / X10_DIMSTEPS, t);
+  }
+
+  st->dimhouse = -1;
+  h = rec->house - 'A';
+  if (h < 0 || h > 15) return 0;
+
+  if (rec->type == 'A') {
+    if (st->afterfunc[h]) {
+      st->addressed[h] = 0;
+      st->afterfunc[h] = 0;
+    }
+    st->addressed[h] |= 1 << (rec->value - 1);
+    return 0;
+  }
+
+  func = rec->value & 0x0F;
+  st->afterfunc[h] = 1;
+  switch (func) {
+  case X10_ALL_UNITS_OFF:
+  case X10_ALL_LIGHTS_ON:
+  case X10_ALL_LIGHTS_OFF:
+    n = applyfunc(st, h, 0xFFFF, func, 0, t);
+    break;
+  case X10_DIM:
+  case X10_BRIGHT:
+    st->dimhouse = h;
+    st->dimfunc = func;
+    n = 0;
+    break;
+  default:
+    n = applyfunc(st, h, st->addressed[h], func, 0, t);
+    break;
+  }
+  return n;
+}
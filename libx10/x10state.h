@@ -0,0 +1,46 @@
+/*  x10state.h  what every X-10 unit was last told to do
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    the power line only says "these units, this function", so the state
+    is rebuilt from decoded records (see x10_decode_batch) the way the
+    modules see them:  addresses collect units of a house, a function
+    applies to all of them, and the next address after a function starts
+    a new set.  one flat array, updated in place, no allocation
+*/
+
+#ifndef X10STATE_H
+#define X10STATE_H
+
+#include <stdint.h>
+#include "x10.h"
+
+#define X10_DIMSTEPS 210	/* CM11A dim/bright data byte for 100% */
+
+struct x10_unitstate {
+  unsigned char on;
+  unsigned char level;	/* brightness percent, kept while off */
+  unsigned char func;	/* last function code applied */
+  uint64_t changed;	/* time of the last change, on the caller's clock */
+};
+
+struct x10_state {
+  /* [house][unit] by index, A-P and 1-16 */
+  struct x10_unitstate unit[16][16];
+  unsigned short addressed[16];	/* bit per unit index */
+  unsigned char afterfunc[16];	/* next address starts a new set */
+  int dimhouse, dimfunc;	/* dim/bright waiting for its data, or -1 */
+  /* units changed since the caller last cleared these */
+  unsigned short dirty[16];
+};
+
+void x10_state_init(struct x10_state *st);
+
+/* applies one record heard at time t, returns the number of units
+   whose on/off or level changed */
+int x10_state_apply(struct x10_state *st, const struct x10_rec *rec, uint64_t t);
+
+#define x10_state_unit(st, houseletter, unitnumber) \
+  (&(st)->unit[(houseletter) - 'A'][(unitnumber) - 1])
+
+#endif
@@ -0,0 +1,310 @@
+/*  avrbench.c  runs a firmware build under simavr with an emulated CM11A
+                or MR26A on its serial port and counts cycles
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    the firmware is the real ATTiny2313 build at 8 MHz, instruction by
+    instruction, so unlike avrsim every cycle is counted.  the receiver
+    is a libx10 emulator in the same virtual time: its bytes go into the
+    UART as they finish on the line and what the firmware sends goes
+    back to it, so a CM11A gets its poll answered.
+    prints "metric value" lines for avrbench.sh to check budgets:
+        frames      CM11A uploads or MR26A frames sent
+        portb       PORTB changes
+        cycles      cycles simulated
+        rxbyte_max  most cycles the main loop spent on one received byte,
+                    cli() to sei(), the UART holds 2 bytes so this must
+                    stay under 2 byte times or bytes are lost
+        frame_avg   main loop cycles per frame, all its bytes
+        irqoff_max  longest time with interrupts off, in cycles
+        isr_max     longest timer interrupt, in cycles
+        stack       bytes of stack used at the deepest
+        overruns    bytes that arrived with 2 still waiting
+    then with -f, cycles per function
+    usage:  avrbench [-m cm11a|mr26a] [-T seconds] [-r rate] [-b burst]
+                     [-n events] [-s seed] [-k keys] [-f symbols] firmware.elf
+            -m the receiver (cm11a)
+            -T seconds of virtual time (60), -r events per second (1),
+            -b events per burst (1), -n stop the emulator after n events,
+            -s random seed
+            -k sends keys at the link rate at start, "!!!?" shows the
+               xvideo10 menu
+            -f "address size type name" lines from avr-nm -S -t d, for
+               cycles per function; __vector_ functions are interrupts
+    build:  cc -O2 -I../libx10 -o avrbench avrbench.c ../libx10/x10emu.c \
+               ../libx10/x10.c -lsimavr -lelf -lm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_ioport.h>
+#include "x10emu.h"
+
+#define CLOCKMHZ 8
+#define MAXFUNCS 64
+#define MAXKEYS 64
+#define VECTORS 38	/* bytes of interrupt vector table */
+
+struct func {
+  unsigned long addr, size;
+  int isr;
+  uint64_t cycles;
+  char name[64];
+};
+
+struct bench {
+  avr_t *avr;
+  avr_irq_t *rxirq;
+  int mr26a;
+  struct cm11a_emu cm;
+  struct mr26a_emu mr;
+  uint64_t bytetime;
+  /* keys sent before the receiver */
+  char keys[MAXKEYS];
+  int nkeys, keyat;
+  /* bytes in the UART the firmware hasn't read */
+  int waiting;
+  uint64_t frames, portbchanges, overruns;
+  unsigned char portb;
+};
+
+struct func funcs[MAXFUNCS];
+int nfuncs = 0;
+
+/* microseconds of virtual time */
+uint64_t usnow(struct bench *b)
+{
+  return b->avr->cycle / CLOCKMHZ;
+}
+
+int loadsymbols(const char *path)
+{
+  char line[256], type[8], name[64];
+  unsigned long addr, size;
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL) return -1;
+  while (fgets(line, sizeof(line), f) != NULL && nfuncs < MAXFUNCS) {
+    if (sscanf(line, "%lu %lu %7s %63s", &addr, &size, type, name) != 4) continue;
+    if (type[0] != 't' && type[0] != 'T') continue;
+    funcs[nfuncs].addr = addr;
+    funcs[nfuncs].size = size;
+    funcs[nfuncs].isr = strncmp(name, "__vector_", 9) == 0;
+    snprintf(funcs[nfuncs].name, sizeof(funcs[nfuncs].name), "%s", name);
+    ++nfuncs;
+  }
+  fclose(f);
+  return 0;
+}
+
+struct func *findfunc(unsigned long pc)
+{
+  int i;
+
+  for (i = 0; i < nfuncs; ++i)
+    if (pc >= funcs[i].addr && pc < funcs[i].addr + funcs[i].size)
+      return &funcs[i];
+  return NULL;
+}
+
+/* a byte from the firmware */
+void txhook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  struct bench *b = param;
+
+  if (!b->mr26a) cm11a_emu_host(&b->cm, usnow(b), value & 0xFF);
+}
+
+/* the UART receive buffer has been emptied */
+void xonhook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  ((struct bench *) param)->waiting = 0;
+}
+
+void portbhook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  struct bench *b = param;
+
+  if ((value & 0xFF) != b->portb) b->portbchanges++;
+  b->portb = value & 0xFF;
+}
+
+void receive(struct bench *b, unsigned char byte)
+{
+  if (b->waiting >= 2) b->overruns++;
+  else b->waiting++;
+  avr_raise_irq(b->rxirq, byte);
+}
+
+/* hands the UART every byte whose stop bit is done by now */
+void feed(struct bench *b)
+{
+  uint64_t t, now = usnow(b);
+  unsigned char byte;
+
+  if (b->keyat < b->nkeys) {
+    if (now >= (uint64_t) (b->keyat + 1) * b->bytetime)
+      receive(b, b->keys[b->keyat++]);
+    return;
+  }
+  if (b->mr26a) {
+    while (mr26a_emu_peek(&b->mr, &t, &byte) && t + b->bytetime <= now) {
+      mr26a_emu_take(&b->mr, NULL);
+      if (byte == MR26A_SYNC1) b->frames++;
+      receive(b, byte);
+    }
+  } else {
+    while (cm11a_emu_peek(&b->cm, &t, &byte) && t + b->bytetime <= now) {
+      cm11a_emu_take(&b->cm);
+      receive(b, byte);
+    }
+    b->frames = b->cm.stats.uploads;
+  }
+}
+
+int main(int argc, char* argv[ ])
+{
+  static struct bench b;
+  struct x10emu_load load;
+  elf_firmware_t fw;
+  struct func *fn;
+  uint32_t flags;
+  uint64_t end, cycle, offstart = 0, isrstart = 0, rxstart = 0;
+  uint64_t irqoffmax = 0, isrmax = 0, rxbytemax = 0, rxcycles = 0;
+  unsigned int sp, spmin;
+  const char *symbols = NULL;
+  double seconds = 60;
+  int c, state, inisr = 0, inrx = 0, ienable = 0;
+
+  x10emu_defaults(&load);
+  opterr = 0;
+  while ((c = getopt(argc, argv, "b:f:k:m:n:r:s:T:")) != -1)
+    switch (c) {
+    case 'b':
+      load.burst = atoi(optarg);
+      break;
+    case 'f':
+      symbols = optarg;
+      break;
+    case 'k':
+      snprintf(b.keys, sizeof(b.keys), "%s", optarg);
+      b.nkeys = strlen(b.keys);
+      break;
+    case 'm':
+      b.mr26a = strcmp(optarg, "mr26a") == 0;
+      break;
+    case 'n':
+      load.maxevents = atol(optarg);
+      break;
+    case 'r':
+      load.rate = atof(optarg);
+      break;
+    case 's':
+      load.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'T':
+      seconds = atof(optarg);
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: avrbench [-m cm11a|mr26a] [-T seconds] [-r rate] [-b burst] "
+	    "[-n events] [-s seed] [-k keys] [-f symbols] firmware.elf\n");
+    exit(-1);
+  }
+  if (symbols != NULL && loadsymbols(symbols) < 0) {
+    fprintf(stderr, "Error reading symbols %s\n", symbols);
+    exit(-1);
+  }
+
+  memset(&fw, 0, sizeof(fw));
+  if (elf_read_firmware(argv[optind], &fw) != 0) {
+    fprintf(stderr, "Error reading firmware %s\n", argv[optind]);
+    exit(-1);
+  }
+  b.avr = avr_make_mcu_by_name("attiny2313");
+  if (b.avr == NULL) {
+    fprintf(stderr, "Error: simavr has no attiny2313\n");
+    exit(-1);
+  }
+  avr_init(b.avr);
+  avr_load_firmware(b.avr, &fw);
+  b.avr->frequency = CLOCKMHZ * 1000000;
+
+  /* the UART talks to the emulator, not simavr's stdout */
+  avr_ioctl(b.avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(b.avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+  b.rxirq = avr_io_getirq(b.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+  avr_irq_register_notify(avr_io_getirq(b.avr, AVR_IOCTL_UART_GETIRQ('0'),
+					UART_IRQ_OUTPUT), txhook, &b);
+  avr_irq_register_notify(avr_io_getirq(b.avr, AVR_IOCTL_UART_GETIRQ('0'),
+					UART_IRQ_OUT_XON), xonhook, &b);
+  avr_irq_register_notify(avr_io_getirq(b.avr, AVR_IOCTL_IOPORT_GETIRQ('B'),
+					IOPORT_IRQ_PIN_ALL), portbhook, &b);
+
+  b.bytetime = b.mr26a ? MR26A_BYTEUS : CM11A_BYTEUS;
+  /* the receiver starts once the keys are in */
+  if (b.mr26a) mr26a_emu_init(&b.mr, &load, (b.nkeys + 1) * b.bytetime);
+  else cm11a_emu_init(&b.cm, &load, (b.nkeys + 1) * b.bytetime);
+
+  end = (uint64_t) (seconds * 1e6) * CLOCKMHZ;
+  spmin = sp = b.avr->ramend;
+  while (b.avr->cycle < end) {
+    feed(&b);
+    cycle = b.avr->cycle;
+    fn = findfunc(b.avr->pc);
+    state = avr_run(b.avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+      fprintf(stderr, "Error: firmware stopped at pc 0x%04X\n", (unsigned) b.avr->pc);
+      break;
+    }
+    if (fn != NULL) fn->cycles += b.avr->cycle - cycle;
+
+    sp = b.avr->data[R_SPL] | b.avr->data[R_SPH] << 8;
+    if (sp < spmin) spmin = sp;
+
+    /* interrupts off and on, and who turned them off */
+    if (b.avr->sreg[S_I] == ienable) continue;
+    ienable = b.avr->sreg[S_I];
+    if (!ienable) {
+      offstart = cycle;
+      /* an interrupt is taken by jumping through the vector table */
+      fn = findfunc(b.avr->pc);
+      inisr = fn != NULL ? fn->isr : b.avr->pc < VECTORS;
+      inrx = !inisr && b.waiting > 0;
+      if (inisr) isrstart = cycle;
+      if (inrx) rxstart = cycle;
+      continue;
+    }
+    if (b.avr->cycle - offstart > irqoffmax) irqoffmax = b.avr->cycle - offstart;
+    if (inisr && b.avr->cycle - isrstart > isrmax) isrmax = b.avr->cycle - isrstart;
+    if (inrx) {
+      rxcycles += b.avr->cycle - rxstart;
+      if (b.avr->cycle - rxstart > rxbytemax) rxbytemax = b.avr->cycle - rxstart;
+    }
+    inisr = inrx = 0;
+  }
+
+  printf("frames %lu\n", (unsigned long) b.frames);
+  printf("portb %lu\n", (unsigned long) b.portbchanges);
+  printf("cycles %lu\n", (unsigned long) b.avr->cycle);
+  printf("rxbyte_max %lu\n", (unsigned long) rxbytemax);
+  printf("frame_avg %lu\n", (unsigned long) (b.frames > 0 ? rxcycles / b.frames : 0));
+  printf("irqoff_max %lu\n", (unsigned long) irqoffmax);
+  printf("isr_max %lu\n", (unsigned long) isrmax);
+  printf("stack %u\n", b.avr->ramend - spmin);
+  printf("overruns %lu\n", (unsigned long) b.overruns);
+  for (c = 0; c < nfuncs; ++c)
+    if (funcs[c].cycles > 0)
+      printf("func %s %lu\n", funcs[c].name, (unsigned long) funcs[c].cycles);
+  return 0;
+}
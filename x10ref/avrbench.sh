@@ -0,0 +1,139 @@
+#!/bin/sh
+#  avrbench.sh  builds every firmware variant for the ATTiny2313, runs it
+#               under simavr with avrbench and checks the numbers against
+#               avrbench.budget
+#  (C) 2013 Tech World Inc
+#  The code released under Open Source Expat MIT License
+#
+#  for each variant prints flash and RAM per function (avr-nm), then
+#  two avrbench runs with the variant's receiver: T seconds of events,
+#  and the menu being shown (metrics named menu_...)
+#  a metric over its budget line is printed as "OVER" and the script
+#  exits 1.  so does a full run while a budget line is still marked
+#  "limit", a hardware limit no regression would reach.  -u rewrites
+#  avrbench.budget from this run, with 10% headroom but never over the
+#  hardware limits below.  -s only builds and checks flash and RAM, for
+#  a machine without simavr
+#  usage:  ./avrbench.sh [-u | -s] [-T seconds] [variant ...]
+#  needs:  avr-gcc, avr-nm, avr-size, and avrbench built (see avrbench.c)
+
+cd "$(dirname "$0")" || exit 1
+
+SECONDS_RUN=60
+UPDATE=0
+SIZEONLY=0
+while getopts "suT:" opt; do
+  case $opt in
+    s) SIZEONLY=1 ;;
+    u) UPDATE=1 ;;
+    T) SECONDS_RUN=$OPTARG ;;
+    *) echo "usage: avrbench.sh [-u | -s] [-T seconds] [variant ...]" >&2; exit 1 ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ $UPDATE = 1 ] && [ $SIZEONLY = 1 ]; then
+  echo "avrbench.sh: -u needs the simavr runs, not -s" >&2
+  exit 1
+fi
+
+# variant, source, receiver, menu keys
+VARIANTS="xvideo10:xvideo10:cm11a:!!!?
+xvideo26:xvideo26:mr26a:?
+cm11a_to_vs4t1:cm11a_to_vs4t1:cm11a:!!!?
+mr26a_to_vs4t1:mr26a_to_vs4t1:mr26a:?
+xvideo-cm11a:xvideo:cm11a:!!!?
+xvideo-mr26a:xvideo:mr26a:?"
+
+# the old SIGNAL()/SIG_ names need the deprecated avr-libc API
+CFLAGS="-mmcu=attiny2313 -Os -DF_CPU=8000000UL -D__AVR_LIBC_DEPRECATED_ENABLE__ -I.."
+OUT=avrbench.out
+BUDGET=avrbench.budget
+mkdir -p $OUT
+rm -f $OUT/failed $OUT/unmeasured
+
+# the limits no budget may pass: 2 KB flash, 128 bytes of RAM with the
+# stack, a received byte handled within the 2 byte UART FIFO at 4800 or
+# 9600 bps, and interrupts back on within one timer period
+limit() {
+  case $2 in
+    flash) echo 2048 ;;
+    ramstack) echo 128 ;;
+    rxbyte_max) case $3 in cm11a) echo 33333 ;; *) echo 16666 ;; esac ;;
+    irqoff_max|menu_irqoff_max) echo 8000000 ;;
+    *) echo "" ;;
+  esac
+}
+
+[ $UPDATE = 1 ] && : > $BUDGET.new
+
+echo "$VARIANTS" | while IFS=: read -r name src rx keys; do
+  if [ $# -gt 0 ]; then
+    case " $* " in *" $name "*|*" $src "*) ;; *) continue ;; esac
+  fi
+
+  elf=$OUT/$src.elf
+  if [ ! -f $elf ] || [ ../$src.c -nt $elf ]; then
+    avr-gcc $CFLAGS -o $elf ../$src.c || { echo "$name: build failed"; touch $OUT/failed; continue; }
+  fi
+  avr-nm -S --size-sort -t d $elf > $OUT/$src.sym
+
+  echo "== $name"
+  echo "-- flash and RAM per function"
+  awk '$3 ~ /^[tT]$/ { printf "  flash %5d %s\n", $2, $4 }
+       $3 ~ /^[bBdD]$/ { printf "  ram   %5d %s\n", $2, $4 }' $OUT/$src.sym
+
+  avr-size -A $elf | awk '$1 == ".text" { t = $2 } $1 == ".data" { d = $2 }
+    $1 == ".bss" { b = $2 } END { print "flash", t + d; print "ram", d + b }' > $OUT/$name.txt
+  if [ $SIZEONLY = 0 ]; then
+    ./avrbench -m $rx -T $SECONDS_RUN -r 2 -f $OUT/$src.sym $elf >> $OUT/$name.txt
+    ./avrbench -m $rx -T 5 -k "$keys" $elf | grep -v '^func' | sed 's/^/menu_/' >> $OUT/$name.txt
+    # the stack comes out of the same 128 bytes
+    awk '$1 == "ram" { r = $2 } $1 == "stack" { s = $2 } $1 == "menu_stack" && $2 > s { s = $2 }
+      END { print "ramstack", r + s }' $OUT/$name.txt >> $OUT/$name.txt
+    echo "-- cycles per function"
+    awk '$1 == "func" { printf "  %10d %s\n", $3, $2 }' $OUT/$name.txt
+  fi
+  echo "-- metrics"
+  grep -v '^func' $OUT/$name.txt | while read -r metric value; do
+    max=$(awk -v n="$name" -v m="$metric" '$1 == n && $2 == m { print $3 }' $BUDGET 2>/dev/null)
+    if [ $SIZEONLY = 0 ] && [ $UPDATE = 0 ] &&
+       awk -v n="$name" -v m="$metric" '$1 == n && $2 == m && $4 == "limit" { f = 1 }
+         END { exit !f }' $BUDGET 2>/dev/null; then
+      echo "$name $metric" >> $OUT/unmeasured
+    fi
+    if [ -n "$max" ] && [ "$value" -gt "$max" ]; then
+      printf "  %-18s %10d  OVER %s\n" $metric $value $max
+      touch $OUT/failed
+    else
+      printf "  %-18s %10d  %s\n" $metric $value "$max"
+    fi
+    if [ $UPDATE = 1 ]; then
+      hard=$(limit $name $metric $rx)
+      new=$((value + value / 10))
+      [ -n "$hard" ] && [ $new -gt $hard ] && new=$hard
+      case $metric in frames|portb|cycles|menu_frames|menu_portb|menu_cycles) ;;
+	*) echo "$name $metric $new" >> $BUDGET.new ;;
+      esac
+    fi
+  done
+done
+
+if [ $UPDATE = 1 ]; then
+  # variants not run keep their lines
+  { echo "# variant  metric  max   written by avrbench.sh -u"
+    awk 'NR == FNR { run[$1] = 1; next } !/^#/ && !($1 in run)' $BUDGET.new $BUDGET 2>/dev/null
+    cat $BUDGET.new; } > $BUDGET.tmp
+  mv $BUDGET.tmp $BUDGET
+  rm -f $BUDGET.new
+fi
+if [ -f $OUT/unmeasured ]; then
+  echo "$(wc -l < $OUT/unmeasured) metrics have only their hardware limit as budget," \
+       "run avrbench.sh -u on a reference machine" >&2
+  rm -f $OUT/unmeasured
+  touch $OUT/failed
+fi
+if [ -f $OUT/failed ]; then
+  rm -f $OUT/failed
+  exit 1
+fi
+exit 0
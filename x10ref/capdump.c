@@ -0,0 +1,69 @@
+/*  capdump.c  prints an X-10 capture file made by rawx10 -c
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    usage:  capdump [-m] [-s start] [-e end] capturefile
+            one line per byte: wall clock time, port, protocol,
+            direction and the byte in hex, e.g.
+                1371234567.123456 0 cm11a rx 5A
+            -s and -e limit the output to a range of wall clock
+            seconds, seeking with the block index, -m reads the file
+            through mmap instead of streaming it
+    build:  cc -O2 -I../libx10 -o capdump capdump.c ../libx10/x10cap.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "x10cap.h"
+
+int main(int argc, char* argv[ ])
+{
+  struct x10cap_reader r;
+  struct x10cap_rec rec;
+  double start = 0, end = 0;
+  uint64_t endt = UINT64_MAX, wall;
+  int c, usemap = 0, err;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "e:ms:")) != -1)
+    switch (c) {
+    case 'e':
+      end = atof(optarg);
+      break;
+    case 'm':
+      usemap = 1;
+      break;
+    case 's':
+      start = atof(optarg);
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: capdump [-m] [-s start] [-e end] capturefile\n");
+    return 1;
+  }
+
+  if (x10cap_open(&r, argv[optind], usemap) < 0) {
+    fprintf(stderr, "Error opening capture %s\n", argv[optind]);
+    return 1;
+  }
+  if (start > 0 && x10cap_seek(&r, (uint64_t) (start * 1e6) - r.anchor) < 0) {
+    fprintf(stderr, "Error: bad block in capture\n");
+    return 1;
+  }
+  if (end > 0) endt = (uint64_t) (end * 1e6) - r.anchor;
+
+  while ((err = x10cap_next(&r, &rec)) > 0 && rec.t < endt) {
+    wall = rec.t + r.anchor;
+    printf("%lu.%06lu %d %s %s %02X\n", (unsigned long) (wall / 1000000),
+	   (unsigned long) (wall % 1000000), x10cap_port(rec.meta),
+	   x10cap_proto(rec.meta) == X10CAP_MR26A ? "mr26a" : "cm11a",
+	   x10cap_dir(rec.meta) == X10CAP_TX ? "tx" : "rx", rec.byte);
+  }
+  if (err < 0) fprintf(stderr, "Error: bad block in capture\n");
+  x10cap_close_reader(&r);
+  return err < 0;
+}
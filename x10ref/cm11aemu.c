@@ -0,0 +1,215 @@
+/*  cm11aemu.c  CM11A emulator on a pseudo-terminal
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    speaks the CM11A side of the serial protocol so rawx10 or anything
+    else that talks to a CM11A can run without one:  polls with 0x5A
+    and retries until it gets 0xC3, uploads the generated events, asks
+    for the time with 0xA5 after a "power fail", and takes transmits
+    (header, code, checksum, 0x00, then 0x55 after the powerline time)
+    prints the pty name on stdout and runs until stopped, so give the
+    other side a fixed name with -l:
+        cm11aemu -n 100 -l /tmp/cm11a & sleep 1; rawx10 -p /tmp/cm11a
+    usage:  cm11aemu [options]
+            -r rate     bursts of events per second (1)
+            -b n        events per burst (1), -g ms apart (50)
+            -H houses   house letters to use (A), -u n units 1-n (16)
+            -a ms       poll retry interval (1000)
+            -P s        power fail every s seconds (never)
+            -T ms       powerline time per transmitted code (417)
+            -d p        chance of dropping an upload byte (0)
+            -B p        chance of an upload count over 9 (0)
+            -C p        chance of a bad transmit checksum (0)
+            -s seed     random seed (1), -n n stop after n events
+            -l path     also make path a symlink to the pty
+            -S s        print statistics every s seconds, and at the end
+    build:  cc -O2 -I../libx10 -o cm11aemu cm11aemu.c ../libx10/x10emu.c ../libx10/x10.c -lm
+*/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "x10emu.h"
+
+volatile sig_atomic_t stopping = 0;
+
+void stopemu(int sig)
+{
+  stopping = 1;
+}
+
+uint64_t now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void printstats(const struct cm11a_emu *e)
+{
+  const struct cm11a_emu_stats *st = &e->stats;
+
+  fprintf(stderr, "events %lu, uploads %lu, polls %lu, poll retries %lu, "
+	  "time requests %lu, time sets %lu\n",
+	  (unsigned long) st->events, (unsigned long) st->uploads,
+	  (unsigned long) st->polls, (unsigned long) st->pollretries,
+	  (unsigned long) st->timereqs, (unsigned long) st->timesets);
+  fprintf(stderr, "dropped bytes %lu, bad counts %lu, transmits %lu, "
+	  "bad checksums %lu, resends %lu\n",
+	  (unsigned long) st->drops, (unsigned long) st->badcounts,
+	  (unsigned long) st->commands, (unsigned long) st->badsums,
+	  (unsigned long) st->resends);
+  x10emu_print_hist(stderr, "poll to ack", &st->acklatency);
+  x10emu_print_hist(stderr, "event to upload", &st->eventlatency);
+}
+
+/* a pty whose slave side is raw and held open, so it survives clients */
+int makepty(const char *link)
+{
+  struct termios tios;
+  int master, slave;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) return -1;
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0) return -1;
+  tcgetattr(slave, &tios);
+  cfmakeraw(&tios);
+  tcsetattr(slave, TCSANOW, &tios);
+
+  if (link != NULL) {
+    unlink(link);
+    if (symlink(ptsname(master), link) < 0) return -1;
+  }
+  printf("%s\n", ptsname(master));
+  fflush(stdout);
+  return master;
+}
+
+int main(int argc, char* argv[ ])
+{
+  struct x10emu_load load;
+  struct cm11a_emu emu;
+  struct pollfd pfd;
+  struct timespec wait;
+  unsigned char buf[64], byte;
+  const char *link = NULL;
+  uint64_t t, statsevery = 0, nextstats = X10EMU_NEVER, until;
+  int c, i, n, fd, haveout;
+
+  x10emu_defaults(&load);
+  opterr = 0;
+  while ((c = getopt(argc, argv, "a:b:d:g:l:n:r:s:u:B:C:H:P:S:T:")) != -1)
+    switch (c) {
+    case 'a':
+      load.acktimeout = atof(optarg) * 1000;
+      break;
+    case 'b':
+      load.burst = atoi(optarg);
+      break;
+    case 'd':
+      load.droprate = atof(optarg);
+      break;
+    case 'g':
+      load.burstgap = atof(optarg) * 1000;
+      break;
+    case 'l':
+      link = optarg;
+      break;
+    case 'n':
+      load.maxevents = atol(optarg);
+      break;
+    case 'r':
+      load.rate = atof(optarg);
+      break;
+    case 's':
+      load.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'u':
+      load.units = atoi(optarg);
+      break;
+    case 'B':
+      load.badcountrate = atof(optarg);
+      break;
+    case 'C':
+      load.badsumrate = atof(optarg);
+      break;
+    case 'H':
+      load.houses = 0;
+      for (i = 0; optarg[i]; ++i)
+	if (x10_parse_house(optarg[i]) >= 0)
+	  load.houses |= 1 << x10_index[x10_parse_house(optarg[i])];
+      break;
+    case 'P':
+      load.powerfail = atof(optarg) * 1e6;
+      break;
+    case 'S':
+      statsevery = atof(optarg) * 1e6;
+      break;
+    case 'T':
+      load.frametime = atof(optarg) * 1000;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+
+  fd = makepty(link);
+  if (fd < 0) {
+    fprintf(stderr, "Error creating pty\n");
+    return 1;
+  }
+  signal(SIGINT, stopemu);
+  signal(SIGTERM, stopemu);
+
+  cm11a_emu_init(&emu, &load, now());
+  if (statsevery > 0) nextstats = now() + statsevery;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  while (!stopping) {
+    /* send what is due, then sleep until the next byte or PC input */
+    while ((haveout = cm11a_emu_peek(&emu, &t, &byte)) && t <= now()) {
+      if (write(fd, &byte, 1) != 1) {
+	fprintf(stderr, "Error writing pty\n");
+	stopping = 1;
+	break;
+      }
+      cm11a_emu_take(&emu);
+    }
+    if (load.maxevents > 0 && cm11a_emu_done(&emu)) break;
+
+    if (now() >= nextstats) {
+      printstats(&emu);
+      nextstats += statsevery;
+    }
+    until = haveout ? t : X10EMU_NEVER;
+    if (nextstats < until) until = nextstats;
+    t = now();
+    if (until == X10EMU_NEVER) n = ppoll(&pfd, 1, NULL, NULL);
+    else {
+      until = until > t ? until - t : 0;
+      wait.tv_sec = until / 1000000;
+      wait.tv_nsec = until % 1000000 * 1000;
+      n = ppoll(&pfd, 1, &wait, NULL);
+    }
+
+    if (n > 0 && (pfd.revents & POLLIN)) {
+      n = read(fd, buf, sizeof(buf));
+      t = now();
+      for (i = 0; i < n; ++i) cm11a_emu_host(&emu, t, buf[i]);
+    }
+  }
+
+  printstats(&emu);
+  if (link != NULL) unlink(link);
+  return 0;
+}
@@ -15,29 +15,91 @@
 		   examples:  "F 0x33" or "A 0x99"
 	       outputs data to stdout as Address, Function, or Data
 	           examples:  "ADDR F04" or "FUNC F On" or "DATA 0x03"
+	       option -b selects batch mode for decoding large archived logs:
+	           input is read in large blocks, hex is parsed by hand and
+	           output comes from precomputed tables and is written in
+	           large chunks instead of one flushed printf per line
+	       option -j threads decodes an archived log file given on
+	           stdin by mapping it and decoding chunks of it on that many
+	           threads (0 = all cores), output is the same as -b
+	       option -s prints statistics instead of lines: how often each
+	           function was sent to each house and unit, with the input
+	           line it was first and last seen on, then the -n top (10)
+	           of them.  -i lines prints them every that many lines too.
+	           memory stays the same however long the log is
+	       option -r ms collapses runs of identical events, the ADDR
+	           lines up to a FUNC line and its DATA lines, into the
+	           event once and a line "RUN count lines first-last span
+	           seconds" when it came more than once.  a run is held at
+	           most ms, so a live stream is never further behind
+	   build: cc -O2 -pthread -I../libx10 -o codex10 codex10.c ../libx10/x10.c
 */
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
+#include "x10.h"
 
 #define BUFSIZE 256
+#define BATCHSIZE (1 << 20)	/* read and write size in batch mode */
+#define MAXOUTLINE 32		/* longest formatted line, with margin */
+#define CHUNKSIZE (4 << 20)	/* input per parallel work item */
+#define FIXLINES 64		/* lines kept to fix up chunk starts */
+#define MAXEVENT (16 * MAXOUTLINE)	/* longest event in -r, it is cut there */
+#define MAXRUNLINE 96		/* longest RUN line */
+
+void codex10_batch(int, int);
+int codex10_parallel(int, int, int);
+void codex10_stats(int, int, uint64_t);
+void codex10_runs(int, int, int);
 
 int main(int argc, char* argv[ ])
 {
   char typebyte, house;
   char aline[BUFSIZE];
   unsigned int abyte, device, datacount = 0;
-  const int devcode[] = {13, 5, 3, 11, 15, 7, 1, 9,
-			 14, 6, 4, 12, 16, 8, 2, 10};
-  const char hcode[] = {'M', 'E', 'C', 'K', 'O', 'G', 'A', 'I',
-			'N', 'F', 'D', 'L', 'P', 'H', 'B', 'J'};
-  const char *funcode[] = {"All_Units_Off", "All_Lights_On", "On", "Off",
-			   "Dim", "Bright", "All_Lights_Off", "Extended_Code",
-			   "Hail_Request", "Hail_Acknowledge",
-			   "Pre-set_Dim(1)", "Pre-set_Dim(2)",
-			   "Extended_Data_Transfer", "Status_On",
-			   "Status_Off", "Status_Request"};
+  int c, stats = 0, top = 10;
+  uint64_t every = 0;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "bi:j:n:r:s")) != -1)
+    switch (c) {
+    case 'b':
+      codex10_batch(0, 1);
+      return 0;
+    case 'i':
+      every = strtoull(optarg, NULL, 0);
+      break;
+    case 'j':
+      /* falls back to batch mode if stdin can't be mapped */
+      if (codex10_parallel(0, 1, atoi(optarg)) < 0) codex10_batch(0, 1);
+      return 0;
+    case 'n':
+      top = atoi(optarg);
+      break;
+    case 'r':
+      codex10_runs(0, 1, atoi(optarg));
+      return 0;
+    case 's':
+      stats = 1;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (stats) {
+    codex10_stats(0, top, every);
+    return 0;
+  }
 
   for(;;) {
     if (fgets(aline, sizeof(aline), stdin) == NULL) {
@@ -61,20 +123,17 @@ int main(int argc, char* argv[ ])
       }
 
       if (typebyte == 'A') {
-	house = hcode[(abyte >> 4) & 0x0F];
-	device = devcode[abyte & 0x0F];
+	house = x10_house_letter(abyte >> 4);
+	device = x10_unit_number(abyte);
 	printf("ADDR %c%02d\n", house, device);
       }
       
       if (typebyte == 'F') {
-	house = hcode[(abyte >> 4) & 0x0F];
-	printf("FUNC %c %s\n", house, funcode[abyte & 0x0F]);
-	/* handle dim and bright data */
-	if ((abyte & 0x0F) == 4 || (abyte & 0x0F) == 5)
-	  datacount = 1;
-	/* handle extended code data */
-	else if ((abyte & 0x0F) == 7 )
-	  datacount = 2;
+	house = x10_house_letter(abyte >> 4);
+	printf("FUNC %c %s\n", house, x10_funcname[abyte & 0x0F]);
+	/* handle dim and bright data, and extended code data */
+	if (x10_datacount[abyte & 0x0F] > 0)
+	  datacount = x10_datacount[abyte & 0x0F];
       }
       
       if (typebyte == 'D') {
@@ -88,3 +147,708 @@ int main(int argc, char* argv[ ])
   return 0;
 }
 
+
+/* batch mode
+   decodes exactly like the loop in main(), but one block at a time:
+   lines are split with memchr, "%c %X" is parsed by hand and every
+   ADDR/FUNC/DATA line is copied from a table built once at startup.
+   lines are whole newline-terminated lines, not BUFSIZE pieces */
+
+struct outline {
+  char text[MAXOUTLINE];
+  unsigned char len;
+};
+
+struct outline addrtab[256], functab[256], datatab[256];
+signed char hexval[256];
+
+void maketables(void)
+{
+  int i;
+
+  for (i = 0; i < 256; ++i) {
+    addrtab[i].len = sprintf(addrtab[i].text, "ADDR %c%02d\n",
+			     x10_house_letter(i >> 4), x10_unit_number(i));
+    functab[i].len = sprintf(functab[i].text, "FUNC %c %s\n",
+			     x10_house_letter(i >> 4), x10_funcname[i & 0x0F]);
+    datatab[i].len = sprintf(datatab[i].text, "DATA 0x%02X\n", i);
+    hexval[i] = -1;
+  }
+  for (i = 0; i < 10; ++i) hexval['0' + i] = i;
+  for (i = 0; i < 6; ++i) hexval['A' + i] = hexval['a' + i] = 10 + i;
+}
+
+/* parses one line the way sscanf(line, "%c %X", ...) does
+   returns 0 for a short line */
+int parseline(const char *p, const char *end, char *typebyte,
+	      unsigned int *abyte)
+{
+  unsigned int val = 0;
+  int neg = 0;
+  const char *digits;
+
+  if (p >= end) return 0;
+  *typebyte = *p++;
+  while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) ++p;
+  if (p < end && (*p == '+' || *p == '-')) neg = (*p++ == '-');
+  if (end - p >= 3 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+      hexval[(unsigned char) p[2]] >= 0)
+    p += 2;
+  for (digits = p; p < end && hexval[(unsigned char) *p] >= 0; ++p)
+    val = (val << 4) | hexval[(unsigned char) *p];
+  if (p == digits) return 0;
+  *abyte = neg ? -val : val;
+  return 1;
+}
+
+/* decodes the line in [p, eol), appends the text at out and returns
+   the end of the text written, out must have room for MAXOUTLINE bytes.
+   a short line is counted in *shortlines, or reported when it is NULL */
+char *decodeline(const char *p, const char *eol, char *out,
+		 unsigned int *datacount, unsigned int *shortlines)
+{
+  const struct outline *ol;
+  char typebyte;
+  unsigned int abyte;
+
+  if (!parseline(p, eol, &typebyte, &abyte)) {
+    if (shortlines != NULL) (*shortlines)++;
+    else fprintf(stderr, "Error; unexpected short line\n");
+    return out;
+  }
+
+  if (*datacount > 0) {
+    typebyte = 'D';
+    (*datacount) --;
+  }
+
+  if (typebyte == 'A') ol = &addrtab[abyte & 0xFF];
+  else if (typebyte == 'F') {
+    ol = &functab[abyte & 0xFF];
+    /* handle dim and bright data, and extended code data */
+    if (x10_datacount[abyte & 0x0F] > 0)
+      *datacount = x10_datacount[abyte & 0x0F];
+  }
+  else if (typebyte == 'D') {
+    if (abyte > 0xFF) return out + sprintf(out, "DATA 0x%02X\n", abyte);
+    ol = &datatab[abyte];
+  }
+  else return out;
+
+  memcpy(out, ol->text, MAXOUTLINE);
+  return out + ol->len;
+}
+
+/* decodes the complete lines in [p, end) into out
+   out must have room for MAXOUTLINE bytes per line */
+char *decodelines(const char *p, const char *end, char *out,
+		  unsigned int *datacount)
+{
+  const char *eol;
+
+  for (; p < end; p = eol + 1) {
+    eol = memchr(p, '\n', end - p);
+    if (eol == NULL) eol = end;
+    out = decodeline(p, eol, out, datacount, NULL);
+  }
+  return out;
+}
+
+/* writes all of len bytes, retrying on short writes */
+int writeall(int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(fd, buf, len);
+    if (n < 0) return -1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+void codex10_batch(int infd, int outfd)
+{
+  char *inbuf, *outbuf, *lastnl, *outend;
+  size_t have = 0;
+  ssize_t numread;
+  unsigned int datacount = 0;
+
+  /* every input line is at least 2 bytes, so at most half as many lines */
+  inbuf = malloc(BATCHSIZE);
+  outbuf = malloc((BATCHSIZE / 2 + 1) * MAXOUTLINE);
+  if (inbuf == NULL || outbuf == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  maketables();
+
+  for(;;) {
+    numread = read(infd, inbuf + have, BATCHSIZE - have);
+    if (numread < 0) {
+      fprintf(stderr, "Error: %s\n", strerror(errno));
+      break;
+    }
+    have += numread;
+
+    /* decode up to the last newline, carry the partial line over */
+    lastnl = numread == 0 ? inbuf + have : memrchr(inbuf, '\n', have);
+    if (lastnl == NULL) {
+      if (have < BATCHSIZE) continue;
+      lastnl = inbuf + have;	/* a single huge line, decode as is */
+    }
+    outend = decodelines(inbuf, lastnl, outbuf, &datacount);
+    if (writeall(outfd, outbuf, outend - outbuf) < 0) {
+      fprintf(stderr, "Error: %s\n", strerror(errno));
+      break;
+    }
+    if (lastnl < inbuf + have) ++lastnl;
+    have -= lastnl - inbuf;
+    memmove(inbuf, lastnl, have);
+
+    if (numread == 0) {
+      fprintf(stderr, "Error; unexpected EOF\n");
+      break;
+    }
+  }
+  free(inbuf);
+  free(outbuf);
+}
+
+/* parallel mode
+   the mapped file is cut into chunks at line boundaries and every chunk
+   is decoded on a worker thread as if it started with datacount 0.
+   a Dim/Bright or Extended_Code line near the end of the previous chunk
+   makes the first lines of a chunk DATA lines instead, so the writer,
+   which sees the chunks in order and knows the real datacount, decodes
+   the start of the chunk again until its state matches the guess and
+   splices the worker output in from there.  while the states don't
+   meet (a long run of Dim lines) the whole chunk is decoded again.
+   the in-order writer makes the output identical to -b */
+
+struct chunk {
+  const char *start, *end;
+  char *out;
+  size_t outlen;
+  int numfix;				/* lines recorded below */
+  size_t fixoff[FIXLINES];		/* output offset after line i */
+  unsigned char fixcount[FIXLINES];	/* datacount after line i */
+  unsigned int endcount;		/* datacount after the chunk */
+  unsigned int shortlines;		/* reported by the writer, in order */
+  int done;
+};
+
+struct parallel {
+  struct chunk *chunks;
+  int numchunks, nextchunk, written, window;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+void decodechunk(struct chunk *ck)
+{
+  const char *p, *eol;
+  char *out;
+  unsigned int datacount = 0;
+  size_t cap = (ck->end - ck->start) * 2 + MAXOUTLINE, len = 0;
+
+  ck->out = malloc(cap);
+  ck->numfix = 0;
+  for (p = ck->start; ck->out != NULL && p < ck->end; p = eol + 1) {
+    eol = memchr(p, '\n', ck->end - p);
+    if (eol == NULL) eol = ck->end;
+    if (cap - len < MAXOUTLINE) {
+      cap *= 2;
+      out = realloc(ck->out, cap);
+      if (out == NULL) free(ck->out);
+      ck->out = out;
+      if (out == NULL) break;
+    }
+    len = decodeline(p, eol, ck->out + len, &datacount, &ck->shortlines) - ck->out;
+    if (ck->numfix < FIXLINES) {
+      ck->fixoff[ck->numfix] = len;
+      ck->fixcount[ck->numfix++] = datacount;
+    }
+  }
+  if (ck->out == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  ck->outlen = len;
+  ck->endcount = datacount;
+}
+
+void *decodeworker(void *arg)
+{
+  struct parallel *par = arg;
+  int k;
+
+  for(;;) {
+    pthread_mutex_lock(&par->lock);
+    /* stay a bounded number of chunks ahead of the writer */
+    while (par->nextchunk < par->numchunks &&
+	   par->nextchunk >= par->written + par->window)
+      pthread_cond_wait(&par->cond, &par->lock);
+    k = par->nextchunk++;
+    pthread_mutex_unlock(&par->lock);
+    if (k >= par->numchunks) break;
+
+    decodechunk(&par->chunks[k]);
+
+    pthread_mutex_lock(&par->lock);
+    par->chunks[k].done = 1;
+    pthread_cond_broadcast(&par->cond);
+    pthread_mutex_unlock(&par->lock);
+  }
+  return NULL;
+}
+
+/* writes chunk ck given the real datacount at its start
+   returns the real datacount after it, or -1 on write errors */
+int writechunk(int outfd, struct chunk *ck, unsigned int startcount)
+{
+  char fixbuf[FIXLINES * MAXOUTLINE], *out = fixbuf, *redo;
+  const char *p, *eol;
+  unsigned int datacount = startcount, shortlines = 0;	/* counted already */
+  int line;
+
+  if (datacount == 0)
+    return writeall(outfd, ck->out, ck->outlen) < 0 ? -1 : (int) ck->endcount;
+
+  for (p = ck->start, line = 0; p < ck->end && line < ck->numfix;
+       p = eol + 1, ++line) {
+    eol = memchr(p, '\n', ck->end - p);
+    if (eol == NULL) eol = ck->end;
+    out = decodeline(p, eol, out, &datacount, &shortlines);
+    if (datacount == ck->fixcount[line]) {
+      /* back in step with the worker, use its output from here on */
+      if (writeall(outfd, fixbuf, out - fixbuf) < 0 ||
+	  writeall(outfd, ck->out + ck->fixoff[line],
+		   ck->outlen - ck->fixoff[line]) < 0)
+	return -1;
+      return ck->endcount;
+    }
+  }
+  if (p >= ck->end)		/* whole chunk was fixed, fixbuf has it all */
+    return writeall(outfd, fixbuf, out - fixbuf) < 0 ? -1 : (int) datacount;
+
+  /* never met, decode the whole chunk again in place of its output */
+  redo = realloc(ck->out, (ck->end - ck->start) / 2 * MAXOUTLINE + MAXOUTLINE);
+  if (redo == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  ck->out = redo;
+  datacount = startcount;
+  for (p = ck->start, out = redo; p < ck->end; p = eol + 1) {
+    eol = memchr(p, '\n', ck->end - p);
+    if (eol == NULL) eol = ck->end;
+    out = decodeline(p, eol, out, &datacount, &shortlines);
+  }
+  return writeall(outfd, redo, out - redo) < 0 ? -1 : (int) datacount;
+}
+
+/* returns -1 without output if infd can't be mapped */
+int codex10_parallel(int infd, int outfd, int numthreads)
+{
+  struct stat st;
+  struct parallel par;
+  pthread_t *threads;
+  const char *map, *p;
+  size_t size;
+  unsigned int i;
+  int k, datacount = 0, err = 0;
+
+  if (fstat(infd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    return -1;
+  size = st.st_size;
+  map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, infd, 0);
+  if (map == MAP_FAILED) return -1;
+  madvise((void *) map, size, MADV_SEQUENTIAL);
+  maketables();
+
+  if (numthreads <= 0) numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (numthreads <= 0) numthreads = 1;
+
+  /* cut into chunks just after a newline */
+  par.numchunks = 0;
+  par.chunks = calloc(size / CHUNKSIZE + 1, sizeof(struct chunk));
+  threads = calloc(numthreads, sizeof(pthread_t));
+  if (par.chunks == NULL || threads == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  for (p = map; p < map + size; ) {
+    par.chunks[par.numchunks].start = p;
+    if ((size_t) (map + size - p) <= CHUNKSIZE) p = map + size;
+    else {
+      p = memchr(p + CHUNKSIZE, '\n', map + size - (p + CHUNKSIZE));
+      p = p == NULL ? map + size : p + 1;
+    }
+    par.chunks[par.numchunks++].end = p;
+  }
+
+  par.nextchunk = par.written = 0;
+  par.window = numthreads * 2;
+  pthread_mutex_init(&par.lock, NULL);
+  pthread_cond_init(&par.cond, NULL);
+  for (k = 0; k < numthreads; ++k)
+    pthread_create(&threads[k], NULL, decodeworker, &par);
+
+  /* write the chunks in order as they finish */
+  for (k = 0; k < par.numchunks; ++k) {
+    pthread_mutex_lock(&par.lock);
+    while (!par.chunks[k].done) pthread_cond_wait(&par.cond, &par.lock);
+    pthread_mutex_unlock(&par.lock);
+
+    for (i = 0; i < par.chunks[k].shortlines; ++i)
+      fprintf(stderr, "Error; unexpected short line\n");
+    datacount = writechunk(outfd, &par.chunks[k], datacount);
+    if (datacount < 0) err = errno;
+    free(par.chunks[k].out);
+    par.chunks[k].out = NULL;
+
+    pthread_mutex_lock(&par.lock);
+    par.written = k + 1;
+    /* after a write error no more chunks are handed out */
+    if (datacount < 0) par.nextchunk = par.numchunks;
+    pthread_cond_broadcast(&par.cond);
+    pthread_mutex_unlock(&par.lock);
+    if (datacount < 0) {
+      fprintf(stderr, "Error: %s\n", strerror(err));
+      break;
+    }
+  }
+
+  for (k = 0; k < numthreads; ++k) pthread_join(threads[k], NULL);
+  if (datacount >= 0) fprintf(stderr, "Error; unexpected EOF\n");
+  for (k = 0; k < par.numchunks; ++k) free(par.chunks[k].out);
+  munmap((void *) map, size);
+  free(par.chunks);
+  free(threads);
+  return 0;
+}
+
+/* statistics mode
+   counts functions in flat arrays indexed by house, unit and function
+   instead of writing lines.  addresses add up until a function, as the
+   firmware sees them, and the function counts once for each unit of
+   its house addressed before it.  functions for the whole house, and
+   any with no unit of its house addressed, count under unit "--" */
+
+/* All_Units_Off, All_Lights_On, All_Lights_Off and the hails */
+#define HOUSEFUNCS (1 << 0 | 1 << 1 | 1 << 6 | 1 << 8 | 1 << 9)
+
+struct counter {
+  uint64_t count, first, last;	/* input lines */
+};
+
+struct statstate {
+  struct counter units[16][16][16];	/* house, unit, function by index */
+  struct counter houses[16][16];	/* house, function with no unit */
+  uint64_t lines, addrs, funcs, data, bad;
+  unsigned int datacount, addressed;	/* bit per unit index */
+  int house, newgroup;
+};
+
+struct ranked {
+  const struct counter *c;
+  int house, unit, func;	/* unit -1 for "--" */
+};
+
+void countfunc(struct counter *c, uint64_t line)
+{
+  if (c->count++ == 0) c->first = line;
+  c->last = line;
+}
+
+/* the line in [p, eol), counted as decodeline() would print it */
+void statline(struct statstate *st, const char *p, const char *eol)
+{
+  char typebyte;
+  unsigned int abyte;
+  int h, u, f;
+
+  ++st->lines;
+  if (!parseline(p, eol, &typebyte, &abyte)) {
+    ++st->bad;
+    return;
+  }
+
+  if (st->datacount > 0) {
+    typebyte = 'D';
+    st->datacount --;
+  }
+
+  h = x10_index[(abyte >> 4) & 0x0F];
+  if (typebyte == 'A') {
+    ++st->addrs;
+    if (st->newgroup || h != st->house) {
+      st->addressed = 0;
+      st->newgroup = 0;
+    }
+    st->house = h;
+    st->addressed |= 1 << x10_index[abyte & 0x0F];
+  }
+  else if (typebyte == 'F') {
+    ++st->funcs;
+    f = abyte & 0x0F;
+    if (h == st->house && st->addressed != 0 && !(HOUSEFUNCS & (1 << f))) {
+      for (u = 0; u < 16; ++u)
+	if (st->addressed & (1 << u)) countfunc(&st->units[h][u][f], st->lines);
+    }
+    else countfunc(&st->houses[h][f], st->lines);
+    st->newgroup = 1;
+    if (x10_datacount[f] > 0) st->datacount = x10_datacount[f];
+  }
+  else if (typebyte == 'D') ++st->data;
+}
+
+void printranked(const struct ranked *r)
+{
+  if (r->unit < 0) printf("%c     --   ", 'A' + r->house);
+  else printf("%c     %02d   ", 'A' + r->house, r->unit + 1);
+  printf("%-22s %10llu %11llu %11llu\n",
+	 x10_funcname[r->func], (unsigned long long) r->c->count,
+	 (unsigned long long) r->c->first, (unsigned long long) r->c->last);
+}
+
+int cmpranked(const void *a, const void *b)
+{
+  const struct ranked *ra = a, *rb = b;
+
+  if (ra->c->count != rb->c->count) return ra->c->count < rb->c->count ? 1 : -1;
+  return ra->c->first < rb->c->first ? -1 : ra->c->first > rb->c->first;
+}
+
+void printstats(const struct statstate *st, int top)
+{
+  static struct ranked ranked[16 * 17 * 16];
+  int h, u, f, n = 0;
+
+  printf("%llu lines, %llu addresses, %llu functions, %llu data, %llu bad\n",
+	 (unsigned long long) st->lines, (unsigned long long) st->addrs,
+	 (unsigned long long) st->funcs, (unsigned long long) st->data,
+	 (unsigned long long) st->bad);
+  printf("house unit function                    count       first        last\n");
+  for (h = 0; h < 16; ++h)
+    for (u = -1; u < 16; ++u)
+      for (f = 0; f < 16; ++f) {
+	ranked[n].c = u < 0 ? &st->houses[h][f] : &st->units[h][u][f];
+	if (ranked[n].c->count == 0) continue;
+	ranked[n].house = h;
+	ranked[n].unit = u;
+	ranked[n].func = f;
+	printranked(&ranked[n++]);
+      }
+
+  if (top <= 0 || n == 0) return;
+  qsort(ranked, n, sizeof(ranked[0]), cmpranked);
+  printf("top %d\n", top < n ? top : n);
+  for (h = 0; h < top && h < n; ++h) printranked(&ranked[h]);
+}
+
+void codex10_stats(int infd, int top, uint64_t every)
+{
+  static struct statstate st;
+  char *inbuf, *p, *eol, *lastnl;
+  size_t have = 0;
+  ssize_t numread;
+
+  inbuf = malloc(BATCHSIZE);
+  if (inbuf == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  maketables();
+  st.house = -1;
+
+  for(;;) {
+    numread = read(infd, inbuf + have, BATCHSIZE - have);
+    if (numread < 0) {
+      fprintf(stderr, "Error: %s\n", strerror(errno));
+      break;
+    }
+    have += numread;
+
+    lastnl = numread == 0 ? inbuf + have : memrchr(inbuf, '\n', have);
+    if (lastnl == NULL) {
+      if (have < BATCHSIZE) continue;
+      lastnl = inbuf + have;
+    }
+    for (p = inbuf; p < lastnl; p = eol + 1) {
+      eol = memchr(p, '\n', lastnl - p);
+      if (eol == NULL) eol = lastnl;
+      statline(&st, p, eol);
+      if (every > 0 && st.lines % every == 0) {
+	printstats(&st, top);
+	printf("\n");
+      }
+    }
+    if (lastnl < inbuf + have) ++lastnl;
+    have -= lastnl - inbuf;
+    memmove(inbuf, lastnl, have);
+
+    if (numread == 0) break;
+  }
+  printstats(&st, top);
+  free(inbuf);
+}
+
+/* run-length mode
+   lines are decoded as in batch mode but held back a whole event at a
+   time.  an event that matches the one before only adds to its run,
+   a different one, the held time running out or the input going quiet
+   that long writes the run out */
+
+struct run {
+  char text[MAXEVENT];
+  size_t len;
+  uint64_t count, first, last;	/* input lines */
+  double start, end;		/* when they were read */
+};
+
+double runclock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* writes the held run at out, returns the end of what was written */
+char *endrun(struct run *held, char *out)
+{
+  if (held->count == 0) return out;
+  memcpy(out, held->text, held->len);
+  out += held->len;
+  if (held->count > 1)
+    out += sprintf(out, "RUN %llu lines %llu-%llu span %.3f s\n",
+		   (unsigned long long) held->count,
+		   (unsigned long long) held->first,
+		   (unsigned long long) held->last, held->end - held->start);
+  held->count = 0;
+  return out;
+}
+
+/* the event in cur, input lines first to last, is complete */
+char *addevent(struct run *held, const char *cur, size_t len, uint64_t first,
+	       uint64_t last, double now, char *out)
+{
+  if (held->count > 0 && held->len == len && memcmp(held->text, cur, len) == 0) {
+    ++held->count;
+    held->last = last;
+    held->end = now;
+    return out;
+  }
+  out = endrun(held, out);
+  memcpy(held->text, cur, len);
+  held->len = len;
+  held->count = 1;
+  held->first = first;
+  held->last = last;
+  held->start = held->end = now;
+  return out;
+}
+
+void codex10_runs(int infd, int outfd, int maxms)
+{
+  static struct run held;
+  char *inbuf, *outbuf, *out, *p, *eol, *lastnl, *end;
+  char cur[MAXEVENT + MAXOUTLINE];
+  size_t have = 0, curlen = 0;
+  ssize_t numread;
+  unsigned int datacount = 0;
+  uint64_t line = 0, curfirst = 0;
+  int infunc = 0, quiet = 0;
+  double now, wait;
+  struct pollfd pfd;
+
+  inbuf = malloc(BATCHSIZE);
+  outbuf = malloc(BATCHSIZE + MAXEVENT + MAXOUTLINE + MAXRUNLINE);
+  if (inbuf == NULL || outbuf == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  maketables();
+
+  for(;;) {
+    out = outbuf;
+    /* while something is held, only wait for input until it is due */
+    if (held.count > 0 || curlen > 0) {
+      now = runclock();
+      wait = held.count > 0 ? held.start + maxms / 1e3 - now : maxms / 1e3;
+      pfd.fd = infd;
+      pfd.events = POLLIN;
+      quiet = wait <= 0 || poll(&pfd, 1, (int) (wait * 1e3) + 1) == 0;
+    }
+    if (quiet) {
+      out = endrun(&held, out);
+      memcpy(out, cur, curlen);
+      out += curlen;
+      curlen = 0;
+      quiet = 0;
+      if (writeall(outfd, outbuf, out - outbuf) < 0) {
+	fprintf(stderr, "Error: %s\n", strerror(errno));
+	break;
+      }
+      continue;
+    }
+
+    numread = read(infd, inbuf + have, BATCHSIZE - have);
+    if (numread < 0) {
+      fprintf(stderr, "Error: %s\n", strerror(errno));
+      break;
+    }
+    have += numread;
+    now = runclock();
+
+    lastnl = numread == 0 ? inbuf + have : memrchr(inbuf, '\n', have);
+    if (lastnl == NULL) {
+      if (have < BATCHSIZE) continue;
+      lastnl = inbuf + have;
+    }
+    for (p = inbuf; p < lastnl; p = eol + 1) {
+      eol = memchr(p, '\n', lastnl - p);
+      if (eol == NULL) eol = lastnl;
+      ++line;
+      end = decodeline(p, eol, cur + curlen, &datacount, NULL);
+      if (end == cur + curlen) continue;
+      if (curlen == 0) curfirst = line;
+      if (cur[curlen] == 'F') infunc = 1;
+      /* a DATA line with no function before it stands alone */
+      if (cur[curlen] == 'D' && !infunc) infunc = 1;
+      curlen = end - cur;
+      if ((infunc && datacount == 0) || curlen > MAXEVENT - MAXOUTLINE) {
+	out = addevent(&held, cur, curlen, curfirst, line, now, out);
+	curlen = 0;
+	infunc = 0;
+      }
+      if (out - outbuf > BATCHSIZE) {
+	if (writeall(outfd, outbuf, out - outbuf) < 0) break;
+	out = outbuf;
+      }
+    }
+    if (held.count > 0 && now - held.start >= maxms / 1e3) out = endrun(&held, out);
+    if (numread == 0) {
+      out = endrun(&held, out);
+      memcpy(out, cur, curlen);
+      out += curlen;
+    }
+    if (writeall(outfd, outbuf, out - outbuf) < 0) {
+      fprintf(stderr, "Error: %s\n", strerror(errno));
+      break;
+    }
+    if (lastnl < inbuf + have) ++lastnl;
+    have -= lastnl - inbuf;
+    memmove(inbuf, lastnl, have);
+
+    if (numread == 0) {
+      fprintf(stderr, "Error; unexpected EOF\n");
+      break;
+    }
+  }
+  free(inbuf);
+  free(outbuf);
+}
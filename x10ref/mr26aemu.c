@@ -0,0 +1,222 @@
+/*  mr26aemu.c  MR26A emulator on a pseudo-terminal
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    sends D5 AA hh uu AD frames at 9600 bps the way an MR26A passes on
+    what it hears from RF remotes:  each press comes 5 times, a frame
+    time apart with some jitter, several remotes interleave, and frames
+    can be missed or arrive with bytes lost or damaged
+    prints the pty name on stdout, and with -t logs each press as
+    "seconds ADDR A01" / "seconds FUNC A On" (CLOCK_MONOTONIC) when its
+    first byte goes out, to check a reader's dedupe and latency against
+    usage:  mr26aemu [options]
+            -r rate     presses per second over all remotes (1)
+            -b n        presses per burst (1), -g ms apart (50)
+            -R n        remotes (1), -e n repeats per press (5)
+            -G ms       start of one frame to the next (75), -J ms jitter (5)
+            -H houses   house letters to use (A), -u n units 1-n (16)
+            -m p        chance a frame is missed (0)
+            -d p        chance a byte is dropped (0)
+            -c p        chance a byte has a bit flipped (0)
+            -s seed     random seed (1), -n n stop after n presses
+            -t file     log presses to file
+            -l path     also make path a symlink to the pty
+            -S s        print statistics every s seconds, and at the end
+    build:  cc -O2 -I../libx10 -o mr26aemu mr26aemu.c ../libx10/x10emu.c ../libx10/x10.c -lm
+*/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "x10emu.h"
+
+volatile sig_atomic_t stopping = 0;
+
+void stopemu(int sig)
+{
+  stopping = 1;
+}
+
+uint64_t now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void printstats(const struct mr26a_emu *e)
+{
+  const struct mr26a_emu_stats *st = &e->stats;
+
+  fprintf(stderr, "presses %lu, frames %lu, bytes %lu, missed frames %lu, "
+	  "dropped bytes %lu, corrupted bytes %lu\n",
+	  (unsigned long) st->events, (unsigned long) st->frames,
+	  (unsigned long) st->bytes, (unsigned long) st->misses,
+	  (unsigned long) st->drops, (unsigned long) st->corrupts);
+}
+
+void logpress(FILE *f, uint64_t t, const struct x10_cmd *cmd)
+{
+  unsigned long sec = t / 1000000, usec = t % 1000000;
+
+  if (cmd->func == X10_ON || cmd->func == X10_OFF)
+    fprintf(f, "%lu.%06lu ADDR %c%02d\n", sec, usec,
+	    x10_house_letter(cmd->house), x10_unit_number(cmd->unit));
+  fprintf(f, "%lu.%06lu FUNC %c %s\n", sec, usec,
+	  x10_house_letter(cmd->house), x10_funcname[cmd->func]);
+  fflush(f);
+}
+
+/* a pty whose slave side is raw and held open, so it survives clients */
+int makepty(const char *link)
+{
+  struct termios tios;
+  int master, slave;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) return -1;
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0) return -1;
+  tcgetattr(slave, &tios);
+  cfmakeraw(&tios);
+  tcsetattr(slave, TCSANOW, &tios);
+
+  if (link != NULL) {
+    unlink(link);
+    if (symlink(ptsname(master), link) < 0) return -1;
+  }
+  printf("%s\n", ptsname(master));
+  fflush(stdout);
+  return master;
+}
+
+int main(int argc, char* argv[ ])
+{
+  struct x10emu_load load;
+  struct mr26a_emu emu;
+  struct x10_cmd cmd;
+  struct timespec wait;
+  unsigned char byte;
+  const char *link = NULL;
+  FILE *presslog = NULL;
+  uint64_t t, statsevery = 0, nextstats = X10EMU_NEVER, until;
+  int c, i, fd, haveout;
+
+  x10emu_defaults(&load);
+  opterr = 0;
+  while ((c = getopt(argc, argv, "b:c:d:e:g:l:m:n:r:s:t:u:G:H:J:R:S:")) != -1)
+    switch (c) {
+    case 'b':
+      load.burst = atoi(optarg);
+      break;
+    case 'c':
+      load.corruptrate = atof(optarg);
+      break;
+    case 'd':
+      load.droprate = atof(optarg);
+      break;
+    case 'e':
+      load.repeats = atoi(optarg);
+      break;
+    case 'g':
+      load.burstgap = atof(optarg) * 1000;
+      break;
+    case 'l':
+      link = optarg;
+      break;
+    case 'm':
+      load.missrate = atof(optarg);
+      break;
+    case 'n':
+      load.maxevents = atol(optarg);
+      break;
+    case 'r':
+      load.rate = atof(optarg);
+      break;
+    case 's':
+      load.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 't':
+      presslog = fopen(optarg, "w");
+      if (presslog == NULL) {
+	fprintf(stderr, "Error opening %s\n", optarg);
+	exit(-1);
+      }
+      break;
+    case 'u':
+      load.units = atoi(optarg);
+      break;
+    case 'G':
+      load.repeatgap = atof(optarg) * 1000;
+      break;
+    case 'H':
+      load.houses = 0;
+      for (i = 0; optarg[i]; ++i)
+	if (x10_parse_house(optarg[i]) >= 0)
+	  load.houses |= 1 << x10_index[x10_parse_house(optarg[i])];
+      break;
+    case 'J':
+      load.jitter = atof(optarg) * 1000;
+      break;
+    case 'R':
+      load.remotes = atoi(optarg);
+      break;
+    case 'S':
+      statsevery = atof(optarg) * 1e6;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+
+  fd = makepty(link);
+  if (fd < 0) {
+    fprintf(stderr, "Error creating pty\n");
+    return 1;
+  }
+  signal(SIGINT, stopemu);
+  signal(SIGTERM, stopemu);
+
+  mr26a_emu_init(&emu, &load, now());
+  if (statsevery > 0) nextstats = now() + statsevery;
+
+  /* nothing comes back from the PC, so this only waits for the next byte */
+  while (!stopping) {
+    while ((haveout = mr26a_emu_peek(&emu, &t, &byte)) && t <= now()) {
+      if (write(fd, &byte, 1) != 1) {
+	fprintf(stderr, "Error writing pty\n");
+	stopping = 1;
+	break;
+      }
+      if (mr26a_emu_take(&emu, &cmd) && presslog != NULL)
+	logpress(presslog, now(), &cmd);
+    }
+    if (!haveout) break;
+
+    if (now() >= nextstats) {
+      printstats(&emu);
+      nextstats += statsevery;
+    }
+    until = t < nextstats ? t : nextstats;
+    t = now();
+    until = until > t ? until - t : 0;
+    wait.tv_sec = until / 1000000;
+    wait.tv_nsec = until % 1000000 * 1000;
+    nanosleep(&wait, NULL);
+  }
+
+  /* let the reader drain the pty before it goes away */
+  if (!stopping) tcdrain(fd);
+  printstats(&emu);
+  if (presslog != NULL) fclose(presslog);
+  if (link != NULL) unlink(link);
+  return 0;
+}
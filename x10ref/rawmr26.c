@@ -0,0 +1,175 @@
+/*  rawmr26.c  inputs data from serial port connected to an MR26A RF receiver
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    frames the D5 AA hh uu AD stream (see mr26a_rx_byte) and prints each
+    button press once, in the same form as codex10:
+        ADDR A01
+        FUNC A On
+    a remote sends every press about 5 times, and holding dim or bright
+    keeps it going, so a frame the same as one heard less than the dedupe
+    window before is the same press and only moves the window on
+    default port is /dev/ttyS0, overide is option:  -p myport
+    usage:  rawmr26 [-d] [-p port] [-w ms] [-m n] [-t] [-c file [-i n]]
+            -w ms    dedupe window, 0 prints every frame (250)
+            -m n     frames needed before a press is printed (1), 2 or
+                     more keeps out a frame damaged into another code at
+                     the cost of one repeat time
+            -t       prefix each line with CLOCK_MONOTONIC seconds
+            -c file  captures every byte received, with its time, to a
+                     binary capture file (see x10cap.h), -i n sets the
+                     port ID recorded for this port (0-63)
+    build:  cc -O2 -I../libx10 -o rawmr26 rawmr26.c ../libx10/x10.c ../libx10/x10cap.c
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "x10.h"
+#include "x10cap.h"
+
+#define DEFAULTPORT "/dev/ttyS0"
+#define BUFSIZE 256
+
+void readmr26(int, int);
+
+struct x10cap_writer capture;
+int capturing = 0;
+int captureport = 0;
+
+uint64_t dedupewindow = MR26A_DEDUPEWINDOW;
+unsigned int minframes = 1;
+int timestamps = 0;
+struct mr26a_dedupe dedupe;
+
+int main(int argc, char* argv[ ])
+{
+  char optstring[] = "c:di:m:p:tw:";
+  char *port;
+  int c, fd;
+  int debugmode = 0;
+  struct termios tios;
+
+  opterr = 0;
+  port = DEFAULTPORT;
+
+  while ((c = getopt(argc, argv, optstring)) != -1)
+    switch (c) {
+    case 'd':
+      debugmode = 1;
+      fprintf(stderr, "debugmode is on \n");
+      break;
+    case 'p':
+      port = optarg;
+      if (debugmode) fprintf(stderr, "port defined as %s\n", port);
+      break;
+    case 'w':
+      dedupewindow = atof(optarg) * 1000;
+      break;
+    case 'm':
+      minframes = atoi(optarg) > 1 ? atoi(optarg) : 1;
+      break;
+    case 't':
+      timestamps = 1;
+      break;
+    case 'c':
+      if (x10cap_create(&capture, optarg) < 0) {
+	fprintf(stderr, "Error opening capture %s\n", optarg);
+	return 1;
+      }
+      capturing = 1;
+      x10cap_catchstop();
+      break;
+    case 'i':
+      captureport = atoi(optarg) & X10CAP_MAXPORT;
+      break;
+    case '?':
+      printf("Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+
+  fd = open(port, O_RDWR);
+  if(fd < 0) {
+    fprintf(stderr, "Error opening port %s\n", port);
+    return 1;
+  }
+
+  /* set up the serial line in raw mode, 9600 baud */
+  tcgetattr(fd, &tios);
+  cfmakeraw(&tios);
+  cfsetospeed(&tios, B9600);
+  cfsetispeed(&tios, B9600);
+  tcsetattr(fd, TCSANOW, &tios);
+
+  readmr26(fd, debugmode);
+  return 0;
+}
+
+/* records bytes in the capture, if there is one */
+void capturebytes(const unsigned char *buf, int n, uint64_t t)
+{
+  if (capturing &&
+      x10cap_putbytes(&capture, t, x10cap_meta(captureport, X10CAP_MR26A, X10CAP_RX),
+		      buf, n) < 0)
+    fprintf(stderr, "Error writing capture\n");
+}
+
+void printpress(const struct x10_cmd *cmd, uint64_t t)
+{
+  if (cmd->unit != X10_NOUNIT) {
+    if (timestamps) printf("%lu.%06lu ", (unsigned long) (t / 1000000),
+			   (unsigned long) (t % 1000000));
+    printf("ADDR %c%02d\n", x10_house_letter(cmd->house), x10_unit_number(cmd->unit));
+  }
+  if (timestamps) printf("%lu.%06lu ", (unsigned long) (t / 1000000),
+			 (unsigned long) (t % 1000000));
+  printf("FUNC %c %s\n", x10_house_letter(cmd->house), x10_funcname[cmd->func]);
+}
+
+void readmr26(int fd, int debugmode)
+{
+  unsigned char buf[BUFSIZE];
+  struct mr26a_rx rx;
+  struct x10_cmd cmd;
+  uint64_t t;
+  int numread, i, printed;
+
+  mr26a_rx_init(&rx);
+  mr26a_dedupe_init(&dedupe, dedupewindow, minframes);
+
+  for(;;) {
+    numread = read(fd, buf, sizeof(buf));
+    /* stopped, keep the last second of capture */
+    if (x10cap_stopping) {
+      if (x10cap_close(&capture) < 0) fprintf(stderr, "Error writing capture\n");
+      return;
+    }
+    if (numread < 0 && errno == EINTR) continue;
+    if (numread <= 0) {
+      fprintf(stderr, "Error reading port: %s\n",
+	      numread == 0 ? "end of file" : strerror(errno));
+      if (capturing) x10cap_close(&capture);
+      return;
+    }
+    t = x10cap_now();
+    capturebytes(buf, numread, t);
+
+    printed = 0;
+    for (i = 0; i < numread; ++i) {
+      if (!mr26a_rx_byte(&rx, buf[i])) continue;
+      if (mr26a_decode(rx.buf, &cmd) < 0) {
+	if (debugmode) fprintf(stderr, "rx %02X %02X bad frame\n", rx.buf[2], rx.buf[3]);
+	continue;
+      }
+      if (mr26a_newpress(&dedupe, &cmd, t)) {
+	printpress(&cmd, t);
+	printed = 1;
+      } else if (debugmode) fprintf(stderr, "rx %02X %02X repeat\n", rx.buf[2], rx.buf[3]);
+    }
+    if (printed) fflush(stdout);
+  }
+}
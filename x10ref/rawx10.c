@@ -13,27 +13,36 @@
 	         achar is 'A' for address or other data,
 		          'F' for function
                  hex is data from 00 thru FF
+	      option -c file also captures every byte received and sent,
+	         with its time, to a binary capture file (see x10cap.h),
+	         -i n sets the port ID recorded for this port (0-63)
+	      build:  cc -O2 -I../libx10 -o rawx10 rawx10.c ../libx10/cm11a.c ../libx10/x10.c ../libx10/x10cap.c
 */
 
-#include <assert.h>
-#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <termios.h>
 #include <unistd.h>
+#include "cm11a.h"
+#include "x10.h"
+#include "x10cap.h"
 
 #define DEFAULTPORT "/dev/ttyS0"
-#define BUFSIZE 256
 
 void readx10(int, int);
 
+struct x10cap_writer capture;
+int capturing = 0;
+int captureport = 0;
+int debugmode = 0;
+
 int main(int argc, char* argv[ ])
 {
-  char optstring[] = "dp:";
+  char optstring[] = "c:di:p:";
   char *port;
   int c, fd;
-  int debugmode = 0;
-  struct termios tios;
 
   opterr = 0;
   port = DEFAULTPORT;
@@ -48,112 +57,113 @@ int main(int argc, char* argv[ ])
       port = optarg;
       if (debugmode) fprintf(stderr, "port defined as %s\n", port);
       break;
+    case 'c':
+      if (x10cap_create(&capture, optarg) < 0) {
+	fprintf(stderr, "Error opening capture %s\n", optarg);
+	return 1;
+      }
+      capturing = 1;
+      x10cap_catchstop();
+      break;
+    case 'i':
+      captureport = atoi(optarg) & X10CAP_MAXPORT;
+      break;
     case '?':
       printf("Unknown argument: %c\n", optopt);
       exit(-1);
     }
 
-  fd = open(port, O_RDWR);
+  /* the serial line in raw mode, 4800 baud */
+  fd = cm11a_open(port);
   if(fd < 0) {
     fprintf(stderr, "Error opening port %s\n", port);
     return 1;
   }
 
-  /* set up the serial line in raw mode, 4800 baud */
-  tcgetattr(fd, &tios);
-  cfmakeraw(&tios);
-  cfsetospeed(&tios, B4800);
-  cfsetispeed(&tios, B4800);
-  tcsetattr(fd, TCSANOW, &tios);
-
   readx10(fd, debugmode);
   return 0;
 }
 
-/* these codes come from x10 interface */
-#define ANULL 0x00
-#define POLL 0x5A
-#define TIME_REQ 0xA5
-#define ISREADY 0x55
-
-void readx10(int fd, int debugmode)
+/* records bytes in the capture, if there is one */
+void capturebytes(struct cm11a_port *p, const unsigned char *buf, int n, int dir)
 {
-  unsigned char buf[BUFSIZE], buf2[BUFSIZE];
+  if (capturing &&
+      x10cap_putbytes(&capture, x10cap_now(),
+		      x10cap_meta(captureport, X10CAP_CM11A, dir), buf, n) < 0)
+    fprintf(stderr, "Error writing capture\n");
+}
 
-  /* these codes are sent back to x10 interface */
-  const char anull = 0x00;
-  const char pollback = 0xC3;
-  const char time_resp[] = {0x9B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+void printevent(struct cm11a_port *p, int what)
+{
+  switch (what) {
+  case CM11A_RX_POLL:
+    if (debugmode) fprintf(stderr, "rx 5A;  tx C3\n");
+    break;
+  case CM11A_RX_NULL:
+    if (debugmode) fprintf(stderr, "rx 00;  tx 00\n");
+    break;
+  case CM11A_RX_TIMEREQ:
+    if (debugmode) fprintf(stderr, "rx A5;  tx 9B 00 00 00 00 00 00\n");
+    break;
+  case CM11A_RX_READY:
+    if (debugmode) fprintf(stderr, "rx 55;  tx nothing\n");
+    break;
+  case CM11A_RX_BADCOUNT:
+    fprintf(stderr, "Unsynchronized error, dumping buffer\n");
+    break;
+  }
+}
 
-  int numbytes, numread, numread2, i, bitmask;
+void printupload(struct cm11a_port *p, const struct cm11a_rx *rx)
+{
+  int j;
   char typebyte;
 
-  for(;;) {
-    numread = read(fd, buf, 1);
-    switch (buf[0]) {
+  /* first byte is always number of bytes to follow */
+  /* second byte is bitmask, one bit for each following byte */
+  /* bit = 1 means function, bit = 0 means address or data */
+  if (debugmode) {
+    fprintf(stderr, "rx %02X numbytes\n", rx->count);
+    fprintf(stderr, "rx %02X bitmask\n", rx->buf[0]); }
 
-    case POLL:
-      /* send pollback to POLL */
-      write(fd, &pollback, 1);
-      if (debugmode) fprintf(stderr, "rx 5A;  tx C3\n");
-      break;
+  for (j = 0; j < cm11a_upload_len(rx); ++j) {
+    if (cm11a_upload_isfunc(rx, j)) typebyte = 'F';
+    else typebyte = 'A';
 
-    case ANULL:
-      /* send anull to ANULL */
-      write(fd, &anull, 1);
-      if (debugmode) fprintf(stderr, "rx 00;  tx 00\n");
-      break;
+    printf("%c 0x%02X\n", typebyte, (int) cm11a_upload_code(rx, j));
 
-    case TIME_REQ:
-      /* send time_resp to TIME_REQ */
-      write(fd, &time_resp, sizeof(time_resp));
-      if (debugmode) fprintf(stderr, "rx A5;  tx 9B 00 00 00 00 00 00\n");
-      break;
+    if (debugmode) fprintf(stderr, "rx %02X, type: %c\n", cm11a_upload_code(rx, j), typebyte);
+  }
+  fflush(stdout);
+}
 
-    case ISREADY:
-      /* send pollback to POLL */
-      if (debugmode) fprintf(stderr, "rx 55;  tx nothing\n");
-      break;
+void readx10(int fd, int debugmode)
+{
+  static const struct cm11a_hooks hooks = {capturebytes, printupload, printevent};
+  struct cm11a_port port;
+  struct pollfd pfd;
+  int n, numread;
 
-    default:
-      /* first byte is always number of bytes to follow */
-      /* second byte is bitmask, one bit for each following byte */
-      /* bit = 1 means function, bit = 0 means address or data */
-      numbytes = buf[0];
+  cm11a_init(&port, fd, &hooks, NULL);
+  pfd.fd = fd;
+  pfd.events = POLLIN;
 
-      if (numbytes > 9) {
-	/* unsynchronized, numbytes can't be > 9, discard buffer */
-	numread = read(fd, buf, 10);
-	fprintf(stderr, "Unsynchronized error, dumping buffer\n");
-      }
-      else {
-	numread = read(fd, buf, numbytes);
-	/* may not be fast enough to grab whole buffer in one shot */
-	if (numread != numbytes) {
-	  numread2 = read(fd, buf2, (numbytes-numread));
-	  for (i = 0; i < numread2; ++i) {
-	    buf[i+numread] = buf2[i];
-	  }
-	  numread = numread + numread2;
-	}
-
-	if (numread != numbytes) fprintf(stderr, "Error: %02X read but %02X expected\n", numread, numbytes);
-	if (debugmode) {
-	  fprintf(stderr, "rx %02X numbytes\n", numbytes);
-	  fprintf(stderr, "rx %02X bitmask\n", buf[0]); }
-      
-	for (i = 1, bitmask = 1; i < numread; ++i, bitmask <<= 1) {
-	  if (buf[0] & bitmask) typebyte = 'F';
-	  else typebyte = 'A';
-
-	  printf("%c 0x%02X\n", typebyte, (int) buf[i]);
-
-	  if (debugmode) fprintf(stderr, "rx %02X, type: %c\n", buf[i], typebyte);
-	}
-      }
-      fflush(stdout);
-      break;
+  for(;;) {
+    /* the timeout is for cm11a_tick, it drops an upload that lost a byte */
+    n = poll(&pfd, 1, cm11a_polltimeout(&port));
+    numread = n > 0 ? cm11a_read(&port) : n;
+    /* stopped, keep the last second of capture */
+    if (x10cap_stopping) {
+      if (x10cap_close(&capture) < 0) fprintf(stderr, "Error writing capture\n");
+      return;
+    }
+    cm11a_tick(&port);
+    if (n == 0 || (numread < 0 && errno == EINTR)) continue;
+    if (numread <= 0) {
+      fprintf(stderr, "Error reading port: %s\n",
+	      numread == 0 ? "end of file" : strerror(errno));
+      if (capturing) x10cap_close(&capture);
+      return;
     }
   }
 }
-  
@@ -0,0 +1,353 @@
+/*  vsfleet.c  sets the menu options of many VS4T1 switches at once
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    opens every port given and drives each switch's menu in parallel:
+    xvideo10 (4800 bps) enters the menu on "!!!" sent before anything
+    else after power up, xvideo26 (9600 bps) on "?".  each option only
+    steps on, C cameras 2-4, S scan time 5-30 sec, H house code A-P and
+    I idle mode S/P/N, and the switch answers every key with its banner,
+    so a key is only sent after the banner for the last one, and the
+    next key is picked from what the banner says.  a lost key costs a
+    banner, not a wrong setting
+    a port given as port:10 or port:26 is that firmware, otherwise
+    xvideo10 is tried first, then xvideo26, in turn until one answers.
+    the combined xvideo image swaps between the two rates every second
+    until it hears a receiver, the tries last 1.5 timeouts so they don't
+    stay in step with it
+    once in the menu the switch is asked for 38400 bps with F, which it
+    answers with an F at the old rate before it changes, and when done
+    X takes it back to run mode.  older firmware ignores both keys, it
+    stays at its rate and in the menu, power it off and on afterwards
+    usage:  vsfleet [-c 2-4] [-s 5-30] [-h A-P] [-i S|P|N] [-t ms] port ...
+    build:  cc -O2 -o vsfleet vsfleet.c
+*/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAXUNITS 256
+#define BUFSIZE 1024
+#define MAXKEYS 40	/* more than any setting needs, with a few lost */
+#define TIMEOUT 1000	/* ms for a banner to start or go on */
+#define MAXTIMEOUTS 5
+
+enum { TRY10, TRY26, INMENU, FAST, LEAVE, DONE, FAILED };
+
+/* one switch */
+struct unit {
+  const char *port;
+  int fd, type, state, keys, timeouts;
+  int fast, left;	/* at 38400 bps, back in run mode */
+  char want[4];		/* the options as the banner shows them */
+  char have[4];
+  char last;		/* key sent, 0 for none */
+  double start, entered, finished, deadline;
+  char buf[BUFSIZE];
+  int len;
+  const char *error;
+};
+
+/* as the firmware keeps them: cameras '2'-'4', scan '0'-'5' for 5-30
+   sec, house 'A'-'P', idle 'S'/'P'/'N', 0 to leave it */
+char target[4] = {0, 0, 0, 0};
+double timeout = TIMEOUT / 1e3;
+
+double seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void setspeed(int fd, speed_t speed)
+{
+  struct termios tios;
+
+  tcgetattr(fd, &tios);
+  cfmakeraw(&tios);
+  cfsetospeed(&tios, speed);
+  cfsetispeed(&tios, speed);
+  tcsetattr(fd, TCSAFLUSH, &tios);
+}
+
+void sendkeys(struct unit *u, const char *keys)
+{
+  if (write(u->fd, keys, strlen(keys)) < 0) {
+    u->state = FAILED;
+    u->error = "write error";
+  }
+  u->deadline = seconds() + timeout;
+  if (u->state != INMENU && u->type == 0) u->deadline += timeout / 2;
+}
+
+/* the keys that bring up the menu of the firmware being tried */
+void trymenu(struct unit *u, int state)
+{
+  u->state = state;
+  if (state == TRY26) {
+    setspeed(u->fd, B9600);
+    /* anything but the sync bytes gets its frame decoder back to the start */
+    sendkeys(u, "\r\r\r?");
+  } else {
+    setspeed(u->fd, B4800);
+    sendkeys(u, "!!!");
+  }
+}
+
+/* sends F or X, the switch answers with the same key */
+void ask(struct unit *u, int state)
+{
+  u->state = state;
+  u->len = 0;
+  sendkeys(u, state == FAST ? "F" : "X");
+  u->deadline = seconds() + timeout / 4;
+}
+
+/* the value after label in the banner, scan time as its two digits */
+int field(const char *banner, const char *label, char *out, int n)
+{
+  const char *p = strstr(banner, label);
+
+  if (p == NULL) return 0;
+  memcpy(out, p + strlen(label), n);
+  return 1;
+}
+
+/* the options from a complete banner, 0 if one is missing */
+int parsebanner(struct unit *u)
+{
+  char scan[2];
+
+  u->buf[u->len] = '\0';
+  if (!field(u->buf, "Cameras:", &u->have[0], 1) || !field(u->buf, "Time:", scan, 2)
+      || !field(u->buf, "Code:", &u->have[2], 1) || !field(u->buf, "Mode:", &u->have[3], 1))
+    return 0;
+  u->have[1] = '0' + (scan[0] - '0') * 2 + (scan[1] == '5') - 1;	/* 05 -> '0' */
+  return 1;
+}
+
+/* the key for the first option that isn't set yet, 0 when all are */
+char nextkey(struct unit *u)
+{
+  static const char keys[4] = {'C', 'S', 'H', 'I'};
+  int i;
+
+  for (i = 0; i < 4; ++i)
+    if (target[i] && u->have[i] != u->want[i]) return keys[i];
+  return 0;
+}
+
+void openunit(struct unit *u, const char *arg)
+{
+  char *colon;
+
+  memset(u, 0, sizeof(*u));
+  u->port = strdup(arg);
+  u->type = 0;
+  if ((colon = strrchr(u->port, ':')) != NULL) {
+    u->type = atoi(colon + 1);
+    *colon = '\0';
+  }
+  u->start = seconds();
+  u->fd = open(u->port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (u->fd < 0) {
+    u->state = FAILED;
+    u->error = "can't open";
+    return;
+  }
+  trymenu(u, u->type == 26 ? TRY26 : TRY10);
+}
+
+/* the key for the next option, or X once they are all set */
+void sendkey(struct unit *u)
+{
+  char key[2] = {0, 0};
+
+  u->len = 0;
+  u->timeouts = 0;
+
+  if ((key[0] = nextkey(u)) == 0) {
+    ask(u, LEAVE);
+    return;
+  }
+  if (++u->keys > MAXKEYS) {
+    u->state = FAILED;
+    u->error = "options don't change";
+    return;
+  }
+  u->last = key[0];
+  sendkeys(u, key);
+}
+
+/* a banner has come in, or the wait for it ran out */
+void step(struct unit *u, int gotbanner)
+{
+  if (u->state == FAST) {
+    u->state = INMENU;
+    if (!gotbanner) {
+      /* no answer, the banner from before still holds */
+      sendkey(u);
+      return;
+    }
+    tcdrain(u->fd);
+    setspeed(u->fd, B38400);
+    u->fast = 1;
+    u->len = 0;
+    sendkeys(u, "?");
+    return;
+  }
+  if (u->state == LEAVE) {
+    u->left = gotbanner;
+    u->state = DONE;
+    u->finished = seconds();
+    return;
+  }
+
+  if (!gotbanner) {
+    if (u->state == TRY10 && u->type != 10) {
+      trymenu(u, TRY26);
+    } else if (u->state == TRY26 && u->type == 0
+	       && ++u->timeouts < MAXTIMEOUTS) {
+      trymenu(u, TRY10);
+    } else if (u->state != INMENU) {
+      u->state = FAILED;
+      u->error = "no banner";
+    } else if (++u->timeouts >= MAXTIMEOUTS) {
+      u->state = FAILED;
+      u->error = "no banner";
+    } else {
+      /* shows the banner again without changing anything */
+      u->last = 0;
+      sendkeys(u, "?");
+    }
+    return;
+  }
+
+  if (!parsebanner(u)) {
+    u->state = FAILED;
+    u->error = "bad banner";
+    return;
+  }
+  if (u->state != INMENU) {
+    u->type = u->state == TRY10 ? 10 : 26;
+    u->state = INMENU;
+    u->entered = seconds();
+    if (nextkey(u)) {
+      ask(u, FAST);
+      return;
+    }
+  }
+  sendkey(u);
+}
+
+/* reads what the switch sent, returns 1 when a banner is complete */
+int readunit(struct unit *u)
+{
+  int n = read(u->fd, u->buf + u->len, BUFSIZE - 1 - u->len);
+
+  if (n <= 0) return 0;
+  /* a banner takes a while, the wait is for it to stop coming */
+  u->deadline = seconds() + timeout;
+  u->len += n;
+  u->buf[u->len] = '\0';
+  if (u->len == BUFSIZE - 1) u->len = 0;
+  if (u->state == FAST || u->state == LEAVE)
+    return memchr(u->buf, u->state == FAST ? 'F' : 'X', u->len) != NULL;
+  /* the last line of each banner, xvideo26 has "?:Menu" near its top */
+  if (strstr(u->buf, "Select Camera\r\n") != NULL) return 1;
+  return strstr(u->buf, "XVideo10") != NULL && strstr(u->buf, "?:Menu\r\n") != NULL;
+}
+
+int main(int argc, char* argv[ ])
+{
+  static struct unit units[MAXUNITS];
+  struct pollfd pfd[MAXUNITS];
+  struct unit *u;
+  int c, i, n, nunits = 0, active, failed = 0;
+  double now, wait, start = seconds();
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "c:h:i:s:t:")) != -1)
+    switch (c) {
+    case 'c':
+      target[0] = optarg[0];
+      break;
+    case 's':
+      target[1] = '0' + atoi(optarg) / 5 - 1;
+      break;
+    case 'h':
+      target[2] = optarg[0] >= 'a' ? optarg[0] - 0x20 : optarg[0];
+      break;
+    case 'i':
+      target[3] = optarg[0] >= 'a' ? optarg[0] - 0x20 : optarg[0];
+      break;
+    case 't':
+      timeout = atof(optarg) / 1e3;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if ((target[0] && (target[0] < '2' || target[0] > '4'))
+      || (target[1] && (target[1] < '0' || target[1] > '5'))
+      || (target[2] && (target[2] < 'A' || target[2] > 'P'))
+      || (target[3] && strchr("SPN", target[3]) == NULL)
+      || optind >= argc || argc - optind > MAXUNITS) {
+    fprintf(stderr, "usage: vsfleet [-c 2-4] [-s 5-30] [-h A-P] [-i S|P|N] [-t ms] port ...\n");
+    exit(-1);
+  }
+  for (i = optind; i < argc; ++i) {
+    u = &units[nunits++];
+    openunit(u, argv[i]);
+    memcpy(u->want, target, 4);
+  }
+
+  for (;;) {
+    active = 0;
+    now = seconds();
+    wait = timeout;
+    for (i = 0; i < nunits; ++i) {
+      u = &units[i];
+      pfd[i].fd = u->state == DONE || u->state == FAILED ? -1 : u->fd;
+      pfd[i].events = POLLIN;
+      if (pfd[i].fd < 0) continue;
+      ++active;
+      if (u->deadline - now < wait) wait = u->deadline - now;
+    }
+    if (active == 0) break;
+    n = poll(pfd, nunits, wait > 0 ? (int) (wait * 1e3) + 1 : 0);
+
+    now = seconds();
+    for (i = 0; i < nunits; ++i) {
+      u = &units[i];
+      if (pfd[i].fd < 0) continue;
+      if (n > 0 && (pfd[i].revents & POLLIN) && readunit(u)) step(u, 1);
+      else if (now >= u->deadline) step(u, 0);
+    }
+  }
+
+  for (i = 0; i < nunits; ++i) {
+    u = &units[i];
+    if (u->state == DONE)
+      printf("%s: xvideo%d%s, %d keys, menu in %.2f s, done in %.2f s, "
+	     "C:%c S:%02d H:%c I:%c%s\n", u->port, u->type,
+	     u->fast ? " at 38400 bps" : "", u->keys,
+	     u->entered - u->start, u->finished - u->start,
+	     u->have[0], (u->have[1] - '0' + 1) * 5, u->have[2], u->have[3],
+	     u->left ? "" : ", still in the menu");
+    else {
+      printf("%s: failed, %s\n", u->port, u->error);
+      ++failed;
+    }
+  }
+  printf("%d switches, %d failed, %.2f s\n", nunits, failed, seconds() - start);
+  return failed > 0;
+}
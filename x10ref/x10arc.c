@@ -0,0 +1,471 @@
+/*  x10arc.c  converts X-10 logs and captures to and from an archive
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    an archive (see x10arc.h) keeps one record per command in columns,
+    a small fraction of the size of the text.  addresses are collected
+    up to their function the way the firmware does, a CM11A group of
+    addresses becomes one record per unit, a function with no address
+    before it one for the whole house
+    adding, the archive is created or continued at its end:
+        text on stdin, lines as codex10, x10merge -d or rawmr26 -t
+        print, optionally after "seconds.micro" and a port:
+            1371234567.123456 0 ADDR A01
+            FUNC A On
+        lines without a time take the time of the line before
+        with -c a capture, decoded as x10merge -d does
+    with -x prints the archive in the form x10merge -d does, -b without
+    the time and port as codex10 does, and with -X writes it back out as
+    a capture: CM11A ports as polls and uploads, MR26A ports as one frame
+    a press.  a record keeps only its function's time, so ADDR lines
+    print with that time, not each with its own as x10merge -d does
+    usage:  x10arc [-m] [-p port] [-f seconds] [-c capture [-w ms] [-n n]]
+                   archive
+            x10arc -x [-b] archive
+            x10arc -X capture archive
+            -m text lines are from an MR26A, -p their port (0)
+            -f writes out what it holds at most this often (60), for a
+               live stream
+            -w ms MR26A dedupe window for -c (250), -n frames needed
+               before a press is kept (1), as x10merge -d
+    build:  cc -O2 -I../libx10 -o x10arc x10arc.c ../libx10/x10.c \
+               ../libx10/x10cap.c ../libx10/x10arc.c
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "x10.h"
+#include "x10cap.h"
+#include "x10arc.h"
+
+#define BUFSIZE 256
+#define FLUSHTIME 60000000	/* microseconds between partial blocks */
+#define MAXCARRY 16		/* records of the longest command, a unit each */
+
+/* addresses and a function waiting for its data, for one port */
+struct pending {
+  unsigned char house;
+  unsigned char units[16];	/* in the order addressed */
+  int nunits;
+  int newgroup;		/* a function came, the next address starts over */
+  struct x10arc_rec func;	/* waiting for datawant data bytes */
+  int datawant, datahave;
+  struct mr26a_dedupe *dedupe;	/* NULL until an MR26A frame */
+};
+
+struct x10arc_writer archive;
+struct pending ports[256];
+uint64_t dedupewindow = MR26A_DEDUPEWINDOW;
+unsigned int minframes = 1;
+unsigned long records, skipped;
+
+void put(const struct x10arc_rec *rec)
+{
+  if (x10arc_put(&archive, rec) < 0) {
+    fprintf(stderr, "Error writing archive\n");
+    exit(1);
+  }
+  records++;
+}
+
+/* the function with its data, to each unit addressed */
+void emit(struct pending *p)
+{
+  struct x10arc_rec rec = p->func;
+  int i;
+
+  p->datawant = 0;
+  if (p->nunits == 0 || p->house != rec.house) {
+    rec.unit = X10_NOUNIT;
+    rec.samecmd = 0;
+    put(&rec);
+    return;
+  }
+  for (i = 0; i < p->nunits; ++i) {
+    rec.unit = p->units[i];
+    rec.samecmd = i > 0;
+    put(&rec);
+  }
+}
+
+void addr(struct pending *p, unsigned int code)
+{
+  int i;
+
+  if (p->newgroup || p->house != code >> 4) p->nunits = 0;
+  p->newgroup = 0;
+  p->house = code >> 4;
+  for (i = 0; i < p->nunits; ++i)
+    if (p->units[i] == (code & 0x0F)) return;
+  p->units[p->nunits++] = code & 0x0F;
+}
+
+/* one code as codex10 sees it: 'A' address, 'F' function, 'D' data */
+void code(int port, uint64_t t, int type, unsigned int byte)
+{
+  struct pending *p = &ports[port];
+
+  if (p->datawant > 0) {
+    p->func.data[p->datahave++] = byte;
+    if (p->datahave == p->datawant) emit(p);
+    return;
+  }
+  if (type == 'A') addr(p, byte);
+  else if (type == 'F') {
+    memset(&p->func, 0, sizeof(p->func));
+    p->func.t = t;
+    p->func.port = port;
+    p->func.house = byte >> 4;
+    p->func.func = byte & 0x0F;
+    p->newgroup = 1;
+    p->datawant = x10_datacount[byte & 0x0F];
+    p->datahave = 0;
+    if (p->datawant == 0) emit(p);
+  }
+}
+
+/* a function still waiting for data at the end goes in without it */
+void endcodes(void)
+{
+  int port;
+
+  for (port = 0; port < 256; ++port)
+    if (ports[port].datawant > 0) emit(&ports[port]);
+}
+
+/* "seconds.micro" to microseconds */
+uint64_t parsetime(const char *s)
+{
+  char *end;
+  uint64_t t = strtoull(s, &end, 10) * 1000000;
+  unsigned long micro;
+  int digits;
+
+  if (*end != '.') return t;
+  s = end + 1;
+  micro = strtoul(s, &end, 10);
+  for (digits = end - s; digits < 6; ++digits) micro *= 10;
+  for (; digits > 6; --digits) micro /= 10;
+  return t + micro;
+}
+
+/* parses "[seconds.micro [port]] ADDR A01|FUNC A On|DATA 0x05"
+   returns the code type, 0 for a line it can't use */
+int parseline(char *line, uint64_t *t, int *port, unsigned int *byte)
+{
+  char *tok[5], **k = tok, *s;
+  int n = 0, house, unit, func;
+
+  for (s = strtok(line, " \t\r\n"); s != NULL && n < 5; s = strtok(NULL, " \t\r\n"))
+    tok[n++] = s;
+  /* a time, and after it a port */
+  if (n > 0 && isdigit((unsigned char) k[0][0])) {
+    *t = parsetime(*k++);
+    --n;
+    if (n > 0 && isdigit((unsigned char) k[0][0])) {
+      *port = x10cap_meta(atoi(*k++) & X10CAP_MAXPORT, x10cap_proto(*port), 0);
+      --n;
+    }
+  }
+  if (n < 2) return 0;
+  if (strcmp(k[0], "DATA") == 0) {
+    *byte = strtoul(k[1], NULL, 16) & 0xFF;
+    return 'D';
+  }
+  if ((house = x10_parse_house(k[1][0])) < 0) return 0;
+  if (strcmp(k[0], "ADDR") == 0 && (unit = x10_parse_unit(atoi(k[1] + 1))) >= 0) {
+    *byte = house << 4 | unit;
+    return 'A';
+  }
+  if (strcmp(k[0], "FUNC") == 0 && n >= 3 && (func = x10_parse_func(k[2])) >= 0) {
+    *byte = house << 4 | func;
+    return 'F';
+  }
+  return 0;
+}
+
+void addtext(int port, uint64_t flushtime)
+{
+  char line[BUFSIZE];
+  uint64_t t = 0, lastflush = x10cap_now();
+  unsigned int byte;
+  int type, lineport;
+
+  while (!x10cap_stopping && fgets(line, sizeof(line), stdin) != NULL) {
+    lineport = port;
+    type = parseline(line, &t, &lineport, &byte);
+    if (type == 0) skipped++;
+    else code(lineport, t, type, byte);
+    if (flushtime > 0 && x10cap_now() - lastflush >= flushtime) {
+      if (x10arc_flush(&archive) < 0) {
+	fprintf(stderr, "Error writing archive\n");
+	exit(1);
+      }
+      lastflush = x10cap_now();
+    }
+  }
+}
+
+/* an MR26A frame, once per press as rawmr26 does */
+void frame(struct pending *p, const unsigned char *buf, uint64_t t, int port)
+{
+  struct x10arc_rec rec;
+  struct x10_cmd cmd;
+
+  if (mr26a_decode(buf, &cmd) < 0) {
+    skipped++;
+    return;
+  }
+  if (p->dedupe == NULL) {
+    if ((p->dedupe = malloc(sizeof(*p->dedupe))) == NULL) {
+      fprintf(stderr, "Error: out of memory\n");
+      exit(1);
+    }
+    mr26a_dedupe_init(p->dedupe, dedupewindow, minframes);
+  }
+  if (!mr26a_newpress(p->dedupe, &cmd, t)) return;
+  memset(&rec, 0, sizeof(rec));
+  rec.t = t;
+  rec.port = port;
+  rec.house = cmd.house;
+  rec.unit = cmd.unit;
+  rec.func = cmd.func;
+  put(&rec);
+}
+
+int addcapture(const char *path)
+{
+  static struct cm11a_rx cm[256];
+  static struct mr26a_rx mr[256];
+  struct x10cap_reader r;
+  struct x10cap_rec rec;
+  uint64_t t;
+  int err = 0, j, port;
+
+  if (x10cap_open(&r, path, 0) < 0) {
+    fprintf(stderr, "Error opening capture %s\n", path);
+    return -1;
+  }
+  for (port = 0; port < 256; ++port) {
+    cm11a_rx_init(&cm[port]);
+    mr26a_rx_init(&mr[port]);
+  }
+  while (!x10cap_stopping && (err = x10cap_next(&r, &rec)) > 0) {
+    if (x10cap_dir(rec.meta) != X10CAP_RX) continue;
+    t = rec.t + r.anchor;
+    port = rec.meta;
+    if (x10cap_proto(rec.meta) == X10CAP_MR26A) {
+      if (mr26a_rx_byte(&mr[port], rec.byte)) frame(&ports[port], mr[port].buf, t, port);
+    } else if (cm11a_rx_byte(&cm[port], rec.byte) == CM11A_RX_UPLOAD)
+      for (j = 0; j < cm11a_upload_len(&cm[port]); ++j)
+	code(port, t, cm11a_upload_isfunc(&cm[port], j) ? 'F' : 'A',
+	     cm11a_upload_code(&cm[port], j));
+  }
+  if (err < 0) fprintf(stderr, "Error: bad block in capture %s\n", path);
+  x10cap_close_reader(&r);
+  return err;
+}
+
+void printtime(const struct x10arc_rec *rec, int bare)
+{
+  if (!bare)
+    printf("%lu.%06lu %d ", (unsigned long) (rec->t / 1000000),
+	   (unsigned long) (rec->t % 1000000), x10cap_port(rec->port));
+}
+
+/* the records of one command: its addresses, function and data */
+void printcmd(const struct x10arc_rec *recs, int n, int bare)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    if (recs[i].unit != X10_NOUNIT) {
+      printtime(recs, bare);
+      printf("ADDR %c%02d\n", x10_house_letter(recs[i].house),
+	     x10_unit_number(recs[i].unit));
+    }
+  printtime(recs, bare);
+  printf("FUNC %c %s\n", x10_house_letter(recs->house), x10_funcname[recs->func]);
+  /* an MR26A Dim or Bright has no data */
+  for (i = 0; x10cap_proto(recs->port) != X10CAP_MR26A && i < x10_datacount[recs->func]; ++i) {
+    printtime(recs, bare);
+    printf("DATA 0x%02X\n", recs->data[i]);
+  }
+}
+
+/* polls and uploads of at most 8 codes for a CM11A, frames for an MR26A
+   returns -1 on write errors */
+int writecmd(struct x10cap_writer *w, const struct x10arc_rec *recs, int n,
+	      int64_t anchor)
+{
+  unsigned char codes[32], buf[16];
+  unsigned int funcmask = 0;
+  uint64_t t = recs->t - anchor;
+  int i, j, len, ncodes = 0, err = 0;
+
+  if (x10cap_proto(recs->port) == X10CAP_MR26A) {
+    for (i = 0; i < n; ++i) {
+      struct x10_cmd cmd = {recs[i].house, recs[i].unit, recs[i].func};
+
+      if (mr26a_encode(buf, &cmd) < 0) {
+	skipped++;
+	continue;
+      }
+      for (j = 0; j < MR26A_FRAMELEN; ++j)
+	err |= x10cap_put(w, t, recs->port | X10CAP_RX, buf[j]);
+    }
+    return err;
+  }
+  for (i = 0; i < n; ++i)
+    if (recs[i].unit != X10_NOUNIT) codes[ncodes++] = recs[i].house << 4 | recs[i].unit;
+  funcmask = 1 << ncodes;
+  codes[ncodes++] = recs->house << 4 | recs->func;
+  for (i = 0; i < x10_datacount[recs->func]; ++i) codes[ncodes++] = recs->data[i];
+  for (i = 0; i < ncodes; i += CM11A_MAXUPLOAD - 1) {
+    len = cm11a_encode_upload(buf, codes + i, funcmask >> i,
+			      ncodes - i < CM11A_MAXUPLOAD - 1 ? ncodes - i
+			      : CM11A_MAXUPLOAD - 1);
+    err |= x10cap_put(w, t, recs->port | X10CAP_RX, CM11A_POLL);
+    err |= x10cap_put(w, t, recs->port | X10CAP_TX, CM11A_POLLACK);
+    for (j = 0; j < len; ++j) err |= x10cap_put(w, t, recs->port | X10CAP_RX, buf[j]);
+  }
+  return err;
+}
+
+/* the records of a command from i to before j */
+int putcmd(struct x10cap_writer *w, const char *cappath,
+	   const struct x10arc_rec *recs, unsigned int i, unsigned int j,
+	   int64_t anchor, int bare)
+{
+  if (cappath == NULL) {
+    printcmd(recs + i, j - i, bare);
+    return 0;
+  }
+  return writecmd(w, recs + i, j - i, anchor);
+}
+
+int extract(const char *path, const char *cappath, int bare)
+{
+  /* the last command of a block waits at the front for the next one,
+     it may go on there */
+  static struct x10arc_rec recs[MAXCARRY + X10ARC_BLOCKRECS];
+  struct x10arc_reader r;
+  struct x10arc_block b;
+  struct x10cap_writer w;
+  int64_t anchor = -1;
+  int err, werr = 0;
+  unsigned int i, j, carry = 0, n;
+
+  if (x10arc_open(&r, path) < 0) {
+    fprintf(stderr, "Error opening archive %s\n", path);
+    return -1;
+  }
+  while ((err = x10arc_nextblock(&r, &b)) > 0) {
+    if (x10arc_decode(&b, X10ARC_ALLCOLS, recs + carry) < 0) {
+      err = -1;
+      break;
+    }
+    if (cappath != NULL && anchor < 0) {
+      anchor = b.tfirst;
+      if (x10cap_create_anchored(&w, cappath, anchor) < 0) {
+	fprintf(stderr, "Error opening capture %s\n", cappath);
+	x10arc_close_reader(&r);
+	return -1;
+      }
+    }
+    n = carry + b.count;
+    for (i = 0; i < n; i = j) {
+      for (j = i + 1; j < n && recs[j].samecmd; ++j);
+      if (j == n && j - i <= MAXCARRY) break;
+      if (putcmd(&w, cappath, recs, i, j, anchor, bare) < 0) werr = -1;
+    }
+    carry = n - i;
+    memmove(recs, recs + i, carry * sizeof(recs[0]));
+    if (werr < 0) {
+      fprintf(stderr, "Error writing capture %s\n", cappath);
+      break;
+    }
+  }
+  if (carry > 0 && werr == 0 && putcmd(&w, cappath, recs, 0, carry, anchor, bare) < 0) {
+    fprintf(stderr, "Error writing capture %s\n", cappath);
+    werr = -1;
+  }
+  if (err < 0) fprintf(stderr, "Error: bad block in archive %s\n", path);
+  x10arc_close_reader(&r);
+  if (cappath != NULL && anchor >= 0 && x10cap_close(&w) < 0) {
+    fprintf(stderr, "Error writing capture %s\n", cappath);
+    werr = -1;
+  }
+  return err < 0 ? err : werr;
+}
+
+int main(int argc, char* argv[ ])
+{
+  const char *capture = NULL, *outcapture = NULL;
+  uint64_t flushtime = FLUSHTIME;
+  int c, port = 0, proto = X10CAP_CM11A, bare = 0, print = 0, err = 0;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "bc:f:mn:p:w:xX:")) != -1)
+    switch (c) {
+    case 'b':
+      bare = 1;
+      break;
+    case 'c':
+      capture = optarg;
+      break;
+    case 'f':
+      flushtime = atof(optarg) * 1e6;
+      break;
+    case 'm':
+      proto = X10CAP_MR26A;
+      break;
+    case 'n':
+      minframes = atoi(optarg) > 1 ? atoi(optarg) : 1;
+      break;
+    case 'p':
+      port = atoi(optarg) & X10CAP_MAXPORT;
+      break;
+    case 'w':
+      dedupewindow = atof(optarg) * 1000;
+      break;
+    case 'x':
+      print = 1;
+      break;
+    case 'X':
+      outcapture = optarg;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: x10arc [-m] [-p port] [-f seconds] [-c capture [-w ms] [-n n]] archive\n"
+	    "       x10arc -x [-b] archive\n       x10arc -X capture archive\n");
+    exit(-1);
+  }
+
+  if (print || outcapture != NULL)
+    return extract(argv[optind], outcapture, bare) < 0 ? 1 : 0;
+
+  if (x10arc_create(&archive, argv[optind]) < 0) {
+    fprintf(stderr, "Error opening archive %s\n", argv[optind]);
+    exit(1);
+  }
+  /* stopped, what was read goes in as the input had ended there */
+  x10cap_catchstop();
+  if (capture != NULL) err = addcapture(capture) < 0;
+  else addtext(x10cap_meta(port, proto, 0), flushtime);
+  endcodes();
+  if (x10arc_close(&archive) < 0) {
+    fprintf(stderr, "Error writing archive %s\n", argv[optind]);
+    err = 1;
+  }
+  fprintf(stderr, "%lu records", records);
+  if (skipped > 0) fprintf(stderr, ", %lu lines or frames skipped", skipped);
+  fprintf(stderr, "\n");
+  return err;
+}
@@ -0,0 +1,99 @@
+/*  x10bench.c  benchmark of the libx10 batch decoder
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    decodes the same random CM11A codes and function masks with
+    x10_decode_batch_scalar and x10_decode_batch, checks that the
+    records match and prints the rate of each in million codes/s
+    usage:  x10bench [-n codes] [-r rounds]
+    build:  cc -O2 -I../libx10 -o x10bench x10bench.c ../libx10/x10.c ../libx10/x10batch.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "x10.h"
+
+#define DEFAULTCODES (16 << 20)
+
+typedef void (*decoder)(const unsigned char *, const unsigned char *,
+			size_t, struct x10_rec *, unsigned int *);
+
+double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* best of rounds, in seconds */
+double timeit(decoder dec, const unsigned char *codes,
+	      const unsigned char *mask, size_t n, struct x10_rec *out,
+	      int rounds)
+{
+  double best = 1e30, t;
+  unsigned int datacount;
+
+  while (rounds-- > 0) {
+    datacount = 0;
+    t = now();
+    dec(codes, mask, n, out, &datacount);
+    t = now() - t;
+    if (t < best) best = t;
+  }
+  return best;
+}
+
+int main(int argc, char* argv[ ])
+{
+  size_t n = DEFAULTCODES, i;
+  int c, rounds = 5;
+  unsigned char *codes, *mask;
+  struct x10_rec *out1, *out2;
+  double tscalar, tbatch;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "n:r:")) != -1)
+    switch (c) {
+    case 'n':
+      n = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+
+  codes = malloc(n);
+  mask = malloc(n / 8 + 1);
+  out1 = malloc(n * sizeof(struct x10_rec));
+  out2 = malloc(n * sizeof(struct x10_rec));
+  if (codes == NULL || mask == NULL || out1 == NULL || out2 == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    return 1;
+  }
+
+  /* about one function per three codes, like address-address-function */
+  srand(1);
+  for (i = 0; i < n; ++i) codes[i] = rand();
+  memset(mask, 0, n / 8 + 1);
+  for (i = 0; i < n; ++i)
+    if (rand() % 3 == 0) mask[i / 8] |= 1 << (i % 8);
+
+  tscalar = timeit(x10_decode_batch_scalar, codes, mask, n, out1, rounds);
+  tbatch = timeit(x10_decode_batch, codes, mask, n, out2, rounds);
+
+  if (memcmp(out1, out2, n * sizeof(struct x10_rec)) != 0) {
+    fprintf(stderr, "Error: batch and scalar records differ\n");
+    return 1;
+  }
+  printf("codes   %lu\n", (unsigned long) n);
+  printf("scalar  %8.1f Mcodes/s\n", n / tscalar / 1e6);
+  printf("batch   %8.1f Mcodes/s  (%.1fx)\n", n / tbatch / 1e6, tscalar / tbatch);
+  return 0;
+}
@@ -0,0 +1,273 @@
+/*  x10lat.c  event to video switch latency of the host build of the
+              firmware against an emulated CM11A or MR26A
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    runs the firmware under avrsim with a libx10 emulator on its serial
+    port, in virtual time, and times each switch from the event to the
+    change of PORTB:  for a CM11A from the POLL that announces the upload,
+    for an MR26A from the first RF frame of the press.  PORTB changes
+    made by the timer interrupt (scanning) aren't switches
+    the load around the events is set with the options, -z runs a sweep:
+        quiet     one event at a time, idle mode N so nothing scans
+        scan      idle mode S and an event every 50 seconds, so the
+                  firmware scans the cameras between events
+        bursts    4 events a burst 50 ms apart, MR26A: 4 remotes
+        repeats   MR26A 10 repeats per press 40 ms apart
+        timereq   CM11A time requests every 10 seconds, each answered
+                  with a 7 byte time set (the firmware's own output)
+    usage:  x10lat10 [-m cm11a|mr26a] [-T seconds] [-E eeprom] [-r rate]
+                     [-b burst] [-g ms] [-e repeats] [-G ms] [-R remotes]
+                     [-P ms] [-H houses] [-u units] [-s seed] [-z]
+            -m the receiver (cm11a)
+            -T seconds of virtual time (600)
+            -E EEPROM as the firmware keeps it (140PN): camera, cameras,
+               scan time 0-5, house code, idle mode S/P/N
+            -r events per second (0.5), -b events per burst (1) -g ms
+               apart (50), -e MR26A repeats per press (5) -G ms apart
+               (75), -R remotes (1), -P ms between CM11A time requests
+            -H houses (P) and -u units 1-n (6) to pick events from
+    build:  one binary per firmware, as x10replay
+            cc -O2 -I../libx10 -I../libx10/avrhost -o x10lat10 x10lat.c \
+               ../xvideo10.c ../libx10/avrsim.c ../libx10/x10emu.c \
+               ../libx10/x10.c -lm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "avrsim.h"
+#include "x10emu.h"
+
+#define BOOTUS 1000000	/* the receiver starts once the firmware is up */
+
+struct lat {
+  int mr26a;
+  struct cm11a_emu cm;
+  struct mr26a_emu mr;
+  struct cm11a_rx cmrx;
+  struct mr26a_rx mrrx;
+  uint64_t peekt;
+  unsigned char peekbyte;
+  /* when each press began, by house, unit and function */
+  uint64_t pressed[16][16][16];
+  uint64_t event;	/* start of the last upload or frame the firmware got */
+  int pending;		/* and it hasn't switched yet */
+  int uploaded;		/* the CM11A upload of that event is in */
+  uint64_t frames, switches, timerswitches;
+  struct x10emu_hist latency;
+};
+
+struct scenario {
+  const char *name;
+  const char *eeprom;
+  double rate;		/* 0 keeps -r */
+  int mr26aonly, cm11aonly;
+  int burst, remotes, repeats;
+  uint64_t repeatgap, powerfail;
+};
+
+int latrx(void *ctx, uint64_t *t, unsigned char *byte)
+{
+  struct lat *l = ctx;
+  int n = l->mr26a ? mr26a_emu_peek(&l->mr, t, byte)
+    : cm11a_emu_peek(&l->cm, t, byte);
+
+  l->peekt = *t;
+  l->peekbyte = *byte;
+  return n;
+}
+
+/* the byte is on its way to the firmware, note where events start */
+void lattake(void *ctx)
+{
+  struct lat *l = ctx;
+  struct x10_cmd cmd;
+
+  if (l->mr26a) {
+    if (mr26a_emu_take(&l->mr, &cmd))
+      l->pressed[cmd.house][cmd.unit & 0x0F][cmd.func] = l->peekt;
+    if (mr26a_rx_byte(&l->mrrx, l->peekbyte)) {
+      l->frames++;
+      if (mr26a_decode(l->mrrx.buf, &cmd) == 0) {
+	l->event = l->pressed[cmd.house][cmd.unit & 0x0F][cmd.func];
+	l->pending = 1;
+      }
+    }
+    return;
+  }
+  cm11a_emu_take(&l->cm);
+  /* a poll retried before the upload is the same event */
+  switch (cm11a_rx_byte(&l->cmrx, l->peekbyte)) {
+  case CM11A_RX_POLL:
+    if (l->pending && !l->uploaded) break;
+    l->event = l->peekt;
+    l->pending = 1;
+    l->uploaded = 0;
+    break;
+  case CM11A_RX_UPLOAD:
+    l->uploaded = 1;
+    break;
+  }
+}
+
+void lattx(void *ctx, uint64_t t, unsigned char byte)
+{
+  struct lat *l = ctx;
+
+  if (!l->mr26a) cm11a_emu_host(&l->cm, t, byte);
+}
+
+void latportb(void *ctx, uint64_t t, unsigned char old, unsigned char now)
+{
+  struct lat *l = ctx;
+
+  if (avrsim_intimer()) {
+    l->timerswitches++;
+    return;
+  }
+  if (!l->pending) return;
+  l->pending = 0;
+  l->switches++;
+  x10emu_record(&l->latency, t - l->event);
+}
+
+void run(const char *name, int mr26a, const struct x10emu_load *load,
+	 const char *eeprom, double seconds)
+{
+  static struct lat l;
+  struct avrsim_io io = {latrx, lattake, lattx, latportb, NULL, &l,
+			 (const unsigned char *) eeprom, strlen(eeprom)};
+  const struct avrsim_stats *st;
+
+  memset(&l, 0, sizeof(l));
+  l.mr26a = mr26a;
+  if (mr26a) mr26a_emu_init(&l.mr, load, BOOTUS);
+  else cm11a_emu_init(&l.cm, load, BOOTUS);
+  cm11a_rx_init(&l.cmrx);
+  mr26a_rx_init(&l.mrrx);
+
+  avrsim_run(&io, 0, seconds * 1e6);
+
+  st = avrsim_stats();
+  printf("%s: %s, %lu %s, %lu switches, %lu by the timer, %lu overruns\n",
+	 name, mr26a ? "mr26a" : "cm11a",
+	 (unsigned long) (mr26a ? l.frames : l.cm.stats.uploads),
+	 mr26a ? "frames" : "uploads", (unsigned long) l.switches,
+	 (unsigned long) l.timerswitches, (unsigned long) st->overruns);
+  x10emu_print_hist(stdout, "latency", &l.latency);
+  if (!mr26a)
+    printf("%lu events, %lu poll retries, %lu time requests, %lu still queued\n",
+	   (unsigned long) l.cm.stats.events, (unsigned long) l.cm.stats.pollretries,
+	   (unsigned long) l.cm.stats.timereqs, (unsigned long) l.cm.qlen);
+  fflush(stdout);
+}
+
+/* each scenario in its own process, the firmware's globals start over */
+void sweep(int mr26a, const struct x10emu_load *base, double seconds)
+{
+  static const struct scenario scenarios[] = {
+    {"quiet", "140PN", 0, 0, 0, 1, 1, 5, MR26A_REPEATUS, 0},
+    {"scan", "140PS", 0.02, 0, 0, 1, 1, 5, MR26A_REPEATUS, 0},
+    {"bursts", "140PN", 0, 0, 0, 4, 4, 5, MR26A_REPEATUS, 0},
+    {"repeats", "140PN", 0, 1, 0, 1, 1, 10, 40000, 0},
+    {"timereq", "140PN", 0, 0, 1, 1, 1, 5, MR26A_REPEATUS, 10000000},
+  };
+  struct x10emu_load load;
+  size_t i;
+  pid_t pid;
+
+  for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+    const struct scenario *sc = &scenarios[i];
+
+    if ((sc->mr26aonly && !mr26a) || (sc->cm11aonly && mr26a)) continue;
+    load = *base;
+    if (sc->rate > 0) load.rate = sc->rate;
+    if (mr26a) load.remotes = sc->remotes;
+    else load.burst = sc->burst;
+    load.repeats = sc->repeats;
+    load.repeatgap = sc->repeatgap;
+    load.powerfail = sc->powerfail;
+    pid = fork();
+    if (pid == 0) {
+      run(sc->name, mr26a, &load, sc->eeprom, seconds);
+      exit(0);
+    }
+    if (pid > 0) waitpid(pid, NULL, 0);
+  }
+}
+
+int main(int argc, char* argv[ ])
+{
+  struct x10emu_load load;
+  const char *eeprom = "140PN";
+  double seconds = 600;
+  int c, i, mr26a = 0, dosweep = 0;
+
+  x10emu_defaults(&load);
+  load.rate = 0.5;
+  load.houses = 1 << 15;
+  load.units = 6;
+  opterr = 0;
+  while ((c = getopt(argc, argv, "b:e:g:m:r:s:u:zE:G:H:P:R:T:")) != -1)
+    switch (c) {
+    case 'b':
+      load.burst = atoi(optarg);
+      break;
+    case 'e':
+      load.repeats = atoi(optarg);
+      break;
+    case 'g':
+      load.burstgap = atof(optarg) * 1000;
+      break;
+    case 'm':
+      mr26a = strcmp(optarg, "mr26a") == 0;
+      break;
+    case 'r':
+      load.rate = atof(optarg);
+      break;
+    case 's':
+      load.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'u':
+      load.units = atoi(optarg);
+      break;
+    case 'z':
+      dosweep = 1;
+      break;
+    case 'E':
+      eeprom = optarg;
+      break;
+    case 'G':
+      load.repeatgap = atof(optarg) * 1000;
+      break;
+    case 'H':
+      load.houses = 0;
+      for (i = 0; optarg[i]; ++i)
+	if (x10_parse_house(optarg[i]) >= 0)
+	  load.houses |= 1 << x10_index[x10_parse_house(optarg[i])];
+      break;
+    case 'P':
+      load.powerfail = atof(optarg) * 1000;
+      break;
+    case 'R':
+      load.remotes = atoi(optarg);
+      break;
+    case 'T':
+      seconds = atof(optarg);
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (strlen(eeprom) != 5) {
+    fprintf(stderr, "usage: -E takes 5 characters, as 140PN\n");
+    exit(-1);
+  }
+
+  if (dosweep) sweep(mr26a, &load, seconds);
+  else run("load", mr26a, &load, eeprom, seconds);
+  return 0;
+}
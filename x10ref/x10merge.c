@@ -0,0 +1,276 @@
+/*  x10merge.c  merges X-10 capture files into one stream in time order
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    reads any number of captures made by rawx10 -c or rawmr26 -c, one
+    per CM11A port or MR26A receiver, and interleaves their records by
+    wall clock time.  a heap holds the next record of each capture, so
+    memory is one block per capture however long they are, and the
+    output starts at once.  records at the same time keep the order of
+    the files on the command line
+    prints capdump lines, or with -o writes a merged capture, or with
+    -d decodes as it merges: CM11A uploads the way rawx10 | codex10
+    does and MR26A frames the way rawmr26 does, each line with its time
+    and port
+        1371234567.123456 0 ADDR A01
+        1371234567.123456 0 FUNC A On
+    usage:  x10merge [-m] [-p] [-d [-w ms] [-n n] | -o merged] [-s start] [-e end]
+                     capture ...
+            -m reads through mmap, otherwise each file is read in
+               order with the kernel told to read ahead
+            -p records each capture as port 0, 1, .. in the order given,
+               for captures that were all made as port 0
+            -d decode, -w ms MR26A dedupe window (250) and -n frames
+               needed before a press is printed (1), as rawmr26 -w, -m
+            -s and -e wall clock seconds to merge, seeking each file
+    build:  cc -O2 -I../libx10 -o x10merge x10merge.c ../libx10/x10.c \
+               ../libx10/x10cap.c
+*/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "x10.h"
+#include "x10cap.h"
+
+#define NUMPORTS (X10CAP_MAXPORT + 1)
+
+/* one capture and its next record */
+struct input {
+  const char *path;
+  struct x10cap_reader r;
+  struct x10cap_rec rec;
+  uint64_t wall;
+  int port;	/* -1 keeps the recorded port */
+};
+
+/* decode state of one port */
+struct portstate {
+  struct cm11a_rx cm;
+  struct mr26a_rx mr;
+  unsigned int datacount;
+  struct mr26a_dedupe *dedupe;	/* NULL until an MR26A frame */
+};
+
+struct input *inputs;
+int *heap, heaplen;
+struct portstate ports[NUMPORTS];
+uint64_t dedupewindow = MR26A_DEDUPEWINDOW;
+unsigned int minframes = 1;
+
+/* earlier time first, the earlier file on a tie */
+int before(int a, int b)
+{
+  if (inputs[a].wall != inputs[b].wall) return inputs[a].wall < inputs[b].wall;
+  return a < b;
+}
+
+void siftdown(int i)
+{
+  int child, tmp;
+
+  for (;;) {
+    child = 2 * i + 1;
+    if (child >= heaplen) return;
+    if (child + 1 < heaplen && before(heap[child + 1], heap[child])) ++child;
+    if (!before(heap[child], heap[i])) return;
+    tmp = heap[i];
+    heap[i] = heap[child];
+    heap[child] = tmp;
+    i = child;
+  }
+}
+
+/* reads the next record of input k, 0 at its end */
+int advance(int k, uint64_t endwall)
+{
+  struct input *in = &inputs[k];
+  int err = x10cap_next(&in->r, &in->rec);
+
+  if (err < 0) fprintf(stderr, "Error: bad block in capture %s\n", in->path);
+  if (err <= 0) return 0;
+  in->wall = in->rec.t + in->r.anchor;
+  if (in->port >= 0)
+    in->rec.meta = x10cap_meta(in->port, x10cap_proto(in->rec.meta),
+			       x10cap_dir(in->rec.meta));
+  return in->wall < endwall;
+}
+
+void printtime(uint64_t wall, int port)
+{
+  printf("%lu.%06lu %d ", (unsigned long) (wall / 1000000),
+	 (unsigned long) (wall % 1000000), port);
+}
+
+/* codes of a CM11A upload, decoded the way codex10 does */
+void decodeupload(struct portstate *ps, const struct cm11a_rx *rx,
+		  uint64_t wall, int port)
+{
+  unsigned int code;
+  int j;
+
+  for (j = 0; j < cm11a_upload_len(rx); ++j) {
+    code = cm11a_upload_code(rx, j);
+    printtime(wall, port);
+    if (ps->datacount > 0) {
+      printf("DATA 0x%02X\n", code);
+      ps->datacount--;
+    } else if (cm11a_upload_isfunc(rx, j)) {
+      printf("FUNC %c %s\n", x10_house_letter(code >> 4),
+	     x10_funcname[code & 0x0F]);
+      /* dim and bright data, and extended code data follow */
+      ps->datacount = x10_datacount[code & 0x0F];
+    } else {
+      printf("ADDR %c%02d\n", x10_house_letter(code >> 4), x10_unit_number(code));
+    }
+  }
+}
+
+/* an MR26A frame, printed once per press as rawmr26 does */
+void decodeframe(struct portstate *ps, uint64_t wall, int port)
+{
+  struct x10_cmd cmd;
+
+  if (mr26a_decode(ps->mr.buf, &cmd) < 0) return;
+  if (ps->dedupe == NULL) {
+    if ((ps->dedupe = malloc(sizeof(*ps->dedupe))) == NULL) {
+      fprintf(stderr, "Error: out of memory\n");
+      exit(1);
+    }
+    mr26a_dedupe_init(ps->dedupe, dedupewindow, minframes);
+  }
+  if (!mr26a_newpress(ps->dedupe, &cmd, wall)) return;
+  if (cmd.unit != X10_NOUNIT) {
+    printtime(wall, port);
+    printf("ADDR %c%02d\n", x10_house_letter(cmd.house), x10_unit_number(cmd.unit));
+  }
+  printtime(wall, port);
+  printf("FUNC %c %s\n", x10_house_letter(cmd.house), x10_funcname[cmd.func]);
+}
+
+void decode(const struct input *in)
+{
+  int port = x10cap_port(in->rec.meta);
+  struct portstate *ps = &ports[port];
+
+  if (x10cap_dir(in->rec.meta) != X10CAP_RX) return;
+  if (x10cap_proto(in->rec.meta) == X10CAP_MR26A) {
+    if (mr26a_rx_byte(&ps->mr, in->rec.byte)) decodeframe(ps, in->wall, port);
+  } else if (cm11a_rx_byte(&ps->cm, in->rec.byte) == CM11A_RX_UPLOAD)
+    decodeupload(ps, &ps->cm, in->wall, port);
+}
+
+int main(int argc, char* argv[ ])
+{
+  struct x10cap_writer w;
+  struct input *in;
+  const char *outpath = NULL;
+  double start = 0, end = 0;
+  uint64_t endwall = UINT64_MAX;
+  int64_t anchor = INT64_MAX;
+  int c, i, k, n, usemap = 0, renumber = 0, decoding = 0, err = 0;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "de:mn:o:ps:w:")) != -1)
+    switch (c) {
+    case 'd':
+      decoding = 1;
+      break;
+    case 'e':
+      end = atof(optarg);
+      break;
+    case 'm':
+      usemap = 1;
+      break;
+    case 'n':
+      minframes = atoi(optarg) > 1 ? atoi(optarg) : 1;
+      break;
+    case 'o':
+      outpath = optarg;
+      break;
+    case 'p':
+      renumber = 1;
+      break;
+    case 's':
+      start = atof(optarg);
+      break;
+    case 'w':
+      dedupewindow = atof(optarg) * 1000;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  n = argc - optind;
+  if (n < 1 || (decoding && outpath != NULL) || (renumber && n > NUMPORTS)) {
+    fprintf(stderr, "usage: x10merge [-m] [-p] [-d [-w ms] [-n n] | -o merged] "
+	    "[-s start] [-e end] capture ...\n");
+    exit(-1);
+  }
+  if (end > 0) endwall = end * 1e6;
+
+  inputs = calloc(n, sizeof(struct input));
+  heap = calloc(n, sizeof(int));
+  if (inputs == NULL || heap == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  for (k = 0; k < NUMPORTS; ++k) {
+    cm11a_rx_init(&ports[k].cm);
+    mr26a_rx_init(&ports[k].mr);
+  }
+
+  for (k = 0; k < n; ++k) {
+    in = &inputs[k];
+    in->path = argv[optind + k];
+    in->port = renumber ? k : -1;
+    if (x10cap_open(&in->r, in->path, usemap) < 0) {
+      fprintf(stderr, "Error opening capture %s\n", in->path);
+      exit(1);
+    }
+    if (!usemap) posix_fadvise(in->r.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (in->r.anchor < anchor) anchor = in->r.anchor;
+    if (start > 0 && (uint64_t) (start * 1e6) > (uint64_t) in->r.anchor &&
+	x10cap_seek(&in->r, (uint64_t) (start * 1e6) - in->r.anchor) < 0) {
+      fprintf(stderr, "Error: bad block in capture %s\n", in->path);
+      continue;
+    }
+    if (advance(k, endwall)) heap[heaplen++] = k;
+  }
+  for (i = heaplen / 2 - 1; i >= 0; --i) siftdown(i);
+
+  /* the earliest anchor keeps every merged time positive */
+  if (outpath != NULL && x10cap_create_anchored(&w, outpath, anchor) < 0) {
+    fprintf(stderr, "Error opening capture %s\n", outpath);
+    exit(1);
+  }
+
+  while (heaplen > 0) {
+    k = heap[0];
+    in = &inputs[k];
+    if (outpath != NULL) {
+      if (x10cap_put(&w, in->wall - anchor, in->rec.meta, in->rec.byte) < 0) {
+	fprintf(stderr, "Error writing capture %s\n", outpath);
+	err = 1;
+	break;
+      }
+    } else if (decoding) decode(in);
+    else {
+      printtime(in->wall, x10cap_port(in->rec.meta));
+      printf("%s %s %02X\n",
+	     x10cap_proto(in->rec.meta) == X10CAP_MR26A ? "mr26a" : "cm11a",
+	     x10cap_dir(in->rec.meta) == X10CAP_TX ? "tx" : "rx", in->rec.byte);
+    }
+    if (!advance(k, endwall)) heap[0] = heap[--heaplen];
+    siftdown(0);
+  }
+
+  if (outpath != NULL && x10cap_close(&w) < 0) {
+    fprintf(stderr, "Error writing capture %s\n", outpath);
+    err = 1;
+  }
+  for (k = 0; k < n; ++k) x10cap_close_reader(&inputs[k].r);
+  return err;
+}
@@ -0,0 +1,348 @@
+/*  x10query.c  finds commands in an X-10 archive
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    prints every record of an archive made by x10arc that matches a
+    unit or house, functions, a port and a time range, in time order:
+        x10query -s 2013-03-01 -e 2013-04-01 log.arc A3 On
+        1362165732.112233 0 A03 On
+    a command to the whole house matches every unit of the house and is
+    printed with the house letter alone.  blocks whose time range, unit
+    bitmap or function mask can't match are passed over by their header,
+    the others are decoded on all cores, each only in the columns the
+    query needs, and printed in order as they finish
+    usage:  x10query [-s start] [-e end] [-p port] [-j threads] [-c] [-d] [-v]
+                     archive [A3|A|*] [function,...]
+            -s and -e seconds or local "2013-03-01 18:00:00", the end is
+               not included, times can be cut after the day or minutes
+            -c prints only the number of matches
+            -d prints local date and time in place of seconds
+            -j threads to decode on (0 = all cores)
+            -v prints how many blocks were read to stderr
+    build:  cc -O2 -pthread -I../libx10 -o x10query x10query.c \
+               ../libx10/x10.c ../libx10/x10arc.c
+*/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "x10.h"
+#include "x10cap.h"
+#include "x10arc.h"
+
+#define MAXLINE 64	/* longest line printed, with margin */
+#define ANYPORT -1
+
+struct query {
+  int house, unit;	/* -1 for any */
+  unsigned int funcmask;
+  int port;
+  uint64_t start, end;
+  int cols;
+  int countonly, dates;
+};
+
+/* one block that may match */
+struct job {
+  struct x10arc_block b;
+  char *out;
+  size_t outlen;
+  unsigned long matches;
+  int bad, done;
+};
+
+struct parallel {
+  struct job *jobs;
+  int numjobs, nextjob, written, window;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+struct query q;
+
+/* seconds, or local time with its fields from the right left out */
+int parsetime(const char *s, uint64_t *t)
+{
+  static const char *const formats[] = {"%Y-%m-%d %H:%M:%S", "%Y-%m-%d %H:%M",
+					 "%Y-%m-%d"};
+  struct tm tm;
+  const char *end;
+  char *numend;
+  size_t i;
+
+  for (i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(s, formats[i], &tm);
+    if (end != NULL && *end == '\0') {
+      tm.tm_isdst = -1;
+      *t = (uint64_t) mktime(&tm) * 1000000;
+      return 0;
+    }
+  }
+  *t = strtod(s, &numend) * 1e6;
+  return *numend == '\0' && numend != s ? 0 : -1;
+}
+
+/* "A3", "A" or "*" */
+int parseunit(const char *s)
+{
+  q.house = q.unit = -1;
+  if (strcmp(s, "*") == 0) return 0;
+  q.house = x10_parse_house(s[0]);
+  if (q.house < 0) return -1;
+  if (s[1] == '\0') return 0;
+  q.unit = x10_parse_unit(atoi(s + 1));
+  return q.unit < 0 ? -1 : 0;
+}
+
+/* "On" or "On,Off,Dim" */
+int parsefuncs(char *s)
+{
+  char *name;
+  int func;
+
+  q.funcmask = 0;
+  for (name = strtok(s, ","); name != NULL; name = strtok(NULL, ",")) {
+    func = x10_parse_func(name);
+    if (func < 0) return -1;
+    q.funcmask |= 1 << func;
+  }
+  return 0;
+}
+
+/* can block b have a match, from its header */
+int blockmatch(const struct x10arc_block *b)
+{
+  if (b->tlast < q.start || b->tfirst >= q.end) return 0;
+  if (!(b->funcmask & q.funcmask)) return 0;
+  if (q.unit >= 0) return x10arc_hasunit(b, q.house, q.unit);
+  if (q.house >= 0) return b->units[q.house << 1] || b->units[(q.house << 1) | 1];
+  return 1;
+}
+
+/* every record of the block matches, nothing to decode to count them */
+int blockall(const struct x10arc_block *b)
+{
+  return q.countonly && q.house < 0 && q.port == ANYPORT &&
+    q.funcmask == 0xFFFF && b->tfirst >= q.start && b->tlast < q.end;
+}
+
+int recmatch(const struct x10arc_rec *rec)
+{
+  if (rec->t < q.start || rec->t >= q.end) return 0;
+  if (!(q.funcmask & (1 << rec->func))) return 0;
+  if (q.house >= 0 && rec->house != q.house) return 0;
+  if (q.unit >= 0 && rec->unit != q.unit && rec->unit != X10_NOUNIT) return 0;
+  return q.port == ANYPORT || x10cap_port(rec->port) == q.port;
+}
+
+char *formatrec(char *out, const struct x10arc_rec *rec)
+{
+  struct tm tm;
+  time_t secs = rec->t / 1000000;
+  int i;
+
+  if (q.dates) {
+    localtime_r(&secs, &tm);
+    out += strftime(out, MAXLINE, "%Y-%m-%d %H:%M:%S", &tm);
+    out += sprintf(out, ".%06lu ", (unsigned long) (rec->t % 1000000));
+  } else
+    out += sprintf(out, "%lu.%06lu ", (unsigned long) secs,
+		   (unsigned long) (rec->t % 1000000));
+  out += sprintf(out, "%d %c", x10cap_port(rec->port), x10_house_letter(rec->house));
+  if (rec->unit != X10_NOUNIT) out += sprintf(out, "%02d", x10_unit_number(rec->unit));
+  out += sprintf(out, " %s", x10_funcname[rec->func]);
+  for (i = 0; i < x10_datacount[rec->func]; ++i)
+    out += sprintf(out, " 0x%02X", rec->data[i]);
+  *out++ = '\n';
+  return out;
+}
+
+void runjob(struct job *jb)
+{
+  struct x10arc_rec recs[X10ARC_BLOCKRECS];
+  char *out;
+  unsigned int i;
+
+  jb->out = NULL;
+  jb->outlen = 0;
+  jb->matches = 0;
+  if (blockall(&jb->b)) {
+    jb->matches = jb->b.count;
+    return;
+  }
+  if (x10arc_decode(&jb->b, q.cols, recs) < 0) {
+    jb->bad = 1;
+    return;
+  }
+  if (!q.countonly) {
+    jb->out = malloc(jb->b.count * MAXLINE);
+    if (jb->out == NULL) {
+      fprintf(stderr, "Error: out of memory\n");
+      exit(1);
+    }
+  }
+  for (i = 0, out = jb->out; i < jb->b.count; ++i) {
+    if (!recmatch(&recs[i])) continue;
+    jb->matches++;
+    if (!q.countonly) out = formatrec(out, &recs[i]);
+  }
+  jb->outlen = out - jb->out;
+}
+
+void *queryworker(void *arg)
+{
+  struct parallel *par = arg;
+  int k;
+
+  for(;;) {
+    pthread_mutex_lock(&par->lock);
+    /* stay a bounded number of blocks ahead of the writer */
+    while (par->nextjob < par->numjobs &&
+	   par->nextjob >= par->written + par->window)
+      pthread_cond_wait(&par->cond, &par->lock);
+    k = par->nextjob++;
+    pthread_mutex_unlock(&par->lock);
+    if (k >= par->numjobs) break;
+
+    runjob(&par->jobs[k]);
+
+    pthread_mutex_lock(&par->lock);
+    par->jobs[k].done = 1;
+    pthread_cond_broadcast(&par->cond);
+    pthread_mutex_unlock(&par->lock);
+  }
+  return NULL;
+}
+
+int main(int argc, char* argv[ ])
+{
+  struct x10arc_reader r;
+  struct x10arc_block b;
+  struct parallel par;
+  pthread_t *threads;
+  unsigned long matches = 0, numblocks = 0;
+  int c, k, err = 0, numthreads = 0, verbose = 0, maxjobs = 1024;
+
+  q.port = ANYPORT;
+  q.start = 0;
+  q.end = UINT64_MAX;
+  q.funcmask = 0xFFFF;
+  q.house = q.unit = -1;
+  opterr = 0;
+  while ((c = getopt(argc, argv, "cde:j:p:s:v")) != -1)
+    switch (c) {
+    case 'c':
+      q.countonly = 1;
+      break;
+    case 'd':
+      q.dates = 1;
+      break;
+    case 'e':
+      if (parsetime(optarg, &q.end) < 0) {
+	fprintf(stderr, "Error: bad time %s\n", optarg);
+	exit(-1);
+      }
+      break;
+    case 'j':
+      numthreads = atoi(optarg);
+      break;
+    case 'p':
+      q.port = atoi(optarg);
+      break;
+    case 's':
+      if (parsetime(optarg, &q.start) < 0) {
+	fprintf(stderr, "Error: bad time %s\n", optarg);
+	exit(-1);
+      }
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (optind >= argc || argc - optind > 3 ||
+      (argc - optind > 1 && parseunit(argv[optind + 1]) < 0) ||
+      (argc - optind > 2 && parsefuncs(argv[optind + 2]) < 0)) {
+    fprintf(stderr, "usage: x10query [-s start] [-e end] [-p port] [-j threads] [-c] [-d] [-v] "
+	    "archive [A3|A|*] [function,...]\n");
+    exit(-1);
+  }
+
+  /* time, house, unit and function to match, port and data to print */
+  q.cols = 1 << X10ARC_TIME | 1 << X10ARC_HOUSE | 1 << X10ARC_UNIT | 1 << X10ARC_FUNC;
+  if (q.port != ANYPORT || !q.countonly) q.cols |= 1 << X10ARC_PORT;
+  if (!q.countonly) q.cols |= 1 << X10ARC_DATA;
+
+  if (x10arc_open(&r, argv[optind]) < 0) {
+    fprintf(stderr, "Error opening archive %s\n", argv[optind]);
+    exit(1);
+  }
+
+  /* the blocks that can match, from their headers alone */
+  par.numjobs = 0;
+  par.jobs = malloc(maxjobs * sizeof(struct job));
+  while (par.jobs != NULL && (err = x10arc_nextblock(&r, &b)) > 0) {
+    numblocks++;
+    if (b.tfirst >= q.end) break;
+    if (!blockmatch(&b)) continue;
+    if (par.numjobs == maxjobs) {
+      maxjobs *= 2;
+      par.jobs = realloc(par.jobs, maxjobs * sizeof(struct job));
+      if (par.jobs == NULL) break;
+    }
+    memset(&par.jobs[par.numjobs], 0, sizeof(struct job));
+    par.jobs[par.numjobs++].b = b;
+  }
+  if (par.jobs == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  if (err < 0) fprintf(stderr, "Error: bad block in archive %s\n", argv[optind]);
+
+  if (numthreads <= 0) numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (numthreads <= 0) numthreads = 1;
+  threads = calloc(numthreads, sizeof(pthread_t));
+  if (threads == NULL) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+  }
+  par.nextjob = par.written = 0;
+  par.window = numthreads * 2;
+  pthread_mutex_init(&par.lock, NULL);
+  pthread_cond_init(&par.cond, NULL);
+  for (k = 0; k < numthreads; ++k)
+    pthread_create(&threads[k], NULL, queryworker, &par);
+
+  /* print the blocks in order as they finish */
+  for (k = 0; k < par.numjobs; ++k) {
+    pthread_mutex_lock(&par.lock);
+    while (!par.jobs[k].done) pthread_cond_wait(&par.cond, &par.lock);
+    pthread_mutex_unlock(&par.lock);
+
+    if (par.jobs[k].bad) fprintf(stderr, "Error: bad block in archive %s\n", argv[optind]);
+    matches += par.jobs[k].matches;
+    fwrite(par.jobs[k].out, 1, par.jobs[k].outlen, stdout);
+    free(par.jobs[k].out);
+
+    pthread_mutex_lock(&par.lock);
+    par.written = k + 1;
+    pthread_cond_broadcast(&par.cond);
+    pthread_mutex_unlock(&par.lock);
+  }
+
+  for (k = 0; k < numthreads; ++k) pthread_join(threads[k], NULL);
+  if (q.countonly) printf("%lu\n", matches);
+  if (verbose)
+    fprintf(stderr, "%d of %lu blocks read, %lu matches\n", par.numjobs, numblocks, matches);
+  x10arc_close_reader(&r);
+  free(par.jobs);
+  free(threads);
+  return 0;
+}
@@ -0,0 +1,179 @@
+/*  x10replay.c  replays a capture into the host build of the firmware
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    feeds the bytes a CM11A or MR26A sent on one port of a capture made
+    with rawx10 -c into xvideo10.c, xvideo26.c or xvideo.c running under
+    avrsim, and prints every change of PORTB (the video switch outputs)
+        1371234567.123456 PORTB F0 -> F2
+    usage:  x10replay10 [-p port] [-w] [-x speed] [-t tail] [-v] capturefile
+            -p replays the bytes received on that capture port (default 0)
+            -w runs at wall clock speed, -x speed times faster than that,
+               the default is as fast as possible in virtual time
+            -t keeps running the firmware timers for tail seconds after
+               the last byte
+            -v also prints the bytes the firmware sends
+            a summary goes to stderr
+    build:  one binary per firmware
+            cc -O2 -I../libx10 -I../libx10/avrhost -o x10replay10 x10replay.c \
+               ../xvideo10.c ../libx10/avrsim.c ../libx10/x10cap.c
+            cc -O2 -I../libx10 -I../libx10/avrhost -o x10replay26 x10replay.c \
+               ../xvideo26.c ../libx10/avrsim.c ../libx10/x10cap.c
+            cc -O2 -I../libx10 -I../libx10/avrhost -o x10replay x10replay.c \
+               ../xvideo.c ../libx10/avrsim.c ../libx10/x10cap.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "avrsim.h"
+#include "x10cap.h"
+
+struct replay {
+  struct x10cap_reader cap;
+  struct x10cap_rec rec;
+  int have;		/* rec holds the next byte for the firmware */
+  int port, verbose;
+  double speed;		/* 0 for as fast as possible */
+  uint64_t vstart;	/* virtual time at the wall clock start */
+  double wstart;
+};
+
+double wallclock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void printtime(struct replay *rp, uint64_t t)
+{
+  uint64_t wall = t + rp->cap.anchor;
+
+  printf("%lu.%06lu", (unsigned long) (wall / 1000000),
+	 (unsigned long) (wall % 1000000));
+}
+
+/* next received byte of the port being replayed */
+int replayrx(void *ctx, uint64_t *t, unsigned char *byte)
+{
+  struct replay *rp = ctx;
+
+  while (!rp->have) {
+    if (x10cap_next(&rp->cap, &rp->rec) <= 0) return 0;
+    rp->have = x10cap_port(rp->rec.meta) == rp->port &&
+      x10cap_dir(rp->rec.meta) == X10CAP_RX;
+  }
+  *t = rp->rec.t;
+  *byte = rp->rec.byte;
+  return 1;
+}
+
+void replaytake(void *ctx)
+{
+  ((struct replay *) ctx)->have = 0;
+}
+
+void replaytx(void *ctx, uint64_t t, unsigned char byte)
+{
+  struct replay *rp = ctx;
+
+  if (!rp->verbose) return;
+  printtime(rp, t);
+  printf(" tx %02X\n", byte);
+}
+
+void replayportb(void *ctx, uint64_t t, unsigned char old, unsigned char now)
+{
+  struct replay *rp = ctx;
+
+  printtime(rp, t);
+  printf(" PORTB %02X -> %02X\n", old, now);
+}
+
+/* holds virtual time to the wall clock, scaled by speed */
+void replayidle(void *ctx, uint64_t from, uint64_t to)
+{
+  struct replay *rp = ctx;
+  double wait;
+
+  if (rp->speed <= 0) return;
+  fflush(stdout);
+  wait = (to - rp->vstart) / 1e6 / rp->speed - (wallclock() - rp->wstart);
+  if (wait > 0) usleep(wait * 1e6);
+}
+
+int main(int argc, char* argv[ ])
+{
+  struct replay rp = {0};
+  struct avrsim_io io = {replayrx, replaytake, replaytx, replayportb,
+			 replayidle, &rp, NULL, 0};
+  const struct avrsim_stats *st;
+  uint64_t start, end = 0;
+  double tail = 0, wall;
+  int c;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "p:t:vwx:")) != -1)
+    switch (c) {
+    case 'p':
+      rp.port = atoi(optarg);
+      break;
+    case 't':
+      tail = atof(optarg);
+      break;
+    case 'v':
+      rp.verbose = 1;
+      break;
+    case 'w':
+      rp.speed = 1;
+      break;
+    case 'x':
+      rp.speed = atof(optarg);
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: x10replay [-p port] [-w] [-x speed] [-t tail] [-v] capturefile\n");
+    return 1;
+  }
+  if (x10cap_open(&rp.cap, argv[optind], 0) < 0) {
+    fprintf(stderr, "Error opening capture %s\n", argv[optind]);
+    return 1;
+  }
+
+  /* the last byte's time bounds the run when there is a tail */
+  if (tail > 0) {
+    while (replayrx(&rp, &end, &rp.rec.byte) > 0) replaytake(&rp);
+    end += tail * 1e6;
+    x10cap_seek(&rp.cap, 0);
+  }
+  if (replayrx(&rp, &start, &rp.rec.byte) <= 0) {
+    fprintf(stderr, "No bytes received on port %d in the capture\n", rp.port);
+    return 1;
+  }
+
+  /* the firmware boots a second before the first byte */
+  start = start > 1000000 ? start - 1000000 : 0;
+  rp.vstart = start;
+  rp.wstart = wall = wallclock();
+  avrsim_run(&io, start, end);
+  wall = wallclock() - wall;
+
+  st = avrsim_stats();
+  fflush(stdout);
+  fprintf(stderr, "%.3f s of traffic replayed in %.3f s (%.0fx)\n",
+	  (avrsim_now() - start) / 1e6, wall,
+	  wall > 0 ? (avrsim_now() - start) / 1e6 / wall : 0);
+  fprintf(stderr, "rx %lu bytes (%lu overruns), tx %lu bytes, "
+	  "%lu timer interrupts, %lu PORTB changes\n",
+	  (unsigned long) st->rxbytes, (unsigned long) st->overruns,
+	  (unsigned long) st->txbytes, (unsigned long) st->interrupts,
+	  (unsigned long) st->portbchanges);
+  x10cap_close_reader(&rp.cap);
+  return 0;
+}
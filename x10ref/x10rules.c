@@ -0,0 +1,421 @@
+/*  x10rules.c  runs X-10 event -> command rules
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    sits on a CM11A (-p port, answering it as rawx10 does), or reads
+    rawx10 output on standard input, and for every function heard on a
+    unit runs the rules for that house, unit and function.  a rule is
+    one line of the rules file:
+        A3 On while A7 Off -> B1 On
+        A* All_Units_Off -> B1 Off, B2 Off
+        C5 Dim while C6 On and C7 Off -> C8 Dim 5
+    a trigger is a unit (A3, or A* for any unit of house A) and a
+    function name as codex10 prints it, the while conditions are units
+    that must be on or off, and each command is printed on standard
+    output as a line "B1 On" or "C8 Dim 5" when the rule fires.  # starts
+    a comment
+    rules are compiled into a table with the rules for each house, unit
+    and function in a row, so an event costs one lookup plus its own
+    rules.  SIGHUP rereads the rules file between two reads of the
+    input, keeping the counters of rules that didn't change, and keeps
+    the old rules if the file has an error.  SIGUSR1, and the end of
+    input, print each rule's hits, times fired and the time from reading
+    the event to its commands being written
+    usage:  x10rules [-d] [-p port] rulesfile
+    build:  cc -O2 -I../libx10 -o x10rules x10rules.c ../libx10/cm11a.c ../libx10/x10state.c ../libx10/x10batch.c ../libx10/x10.c \
+               ../libx10/x10cap.c
+*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cm11a.h"
+#include "x10cap.h"
+#include "x10state.h"
+
+#define MAXRULES 1024
+#define MAXCONDS 8
+#define MAXACTIONS 8
+#define LINESIZE 256
+#define ANYUNIT 0xFF
+
+struct cond {
+  unsigned char house, unit, on;	/* indexes */
+};
+
+struct action {
+  unsigned char house, unit, func;	/* indexes */
+  short data;		/* -1 for none */
+};
+
+struct rule {
+  char text[LINESIZE];
+  unsigned char house, unit, func;	/* trigger, unit may be ANYUNIT */
+  int nconds, nactions;
+  struct cond cond[MAXCONDS];
+  struct action action[MAXACTIONS];
+  uint64_t event;	/* last event run, a house function runs it once */
+  uint64_t hits, fired, latsum, latmax;
+};
+
+struct ruleset {
+  int nrules;
+  struct rule rule[MAXRULES];
+  /* rules for house << 8 | unit << 4 | func (indexes) are
+     index[slot[key]] up to index[slot[key + 1]] */
+  unsigned int slot[4096 + 1];
+  unsigned short index[MAXRULES * 16];
+};
+
+struct ruleset *rules;
+struct x10_state state;
+unsigned int datacount = 0;
+uint64_t eventno = 0, readtime;
+int debugmode = 0;
+volatile sig_atomic_t reload = 0, report = 0;
+
+void sighup(int sig)
+{
+  reload = 1;
+}
+
+void sigusr1(int sig)
+{
+  report = 1;
+}
+
+uint64_t nanoseconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* "A3" or "A*" to indexes, returns 0 if it isn't one */
+int parseunit(const char *word, unsigned char *h, unsigned char *u, int any)
+{
+  int n;
+
+  if (x10_parse_house(word[0]) < 0) return 0;
+  *h = toupper(word[0]) - 'A';
+  if (any && strcmp(word + 1, "*") == 0) {
+    *u = ANYUNIT;
+    return 1;
+  }
+  n = atoi(word + 1);
+  if (x10_parse_unit(n) < 0) return 0;
+  *u = n - 1;
+  return 1;
+}
+
+/* one rule from its line, returns 0 with an error message if bad */
+int parserule(struct rule *r, const char *line, const char **error)
+{
+  char buf[LINESIZE], *word[64], *p;
+  struct action *a;
+  unsigned char h, u;
+  int n = 0, i, f;
+
+  memset(r, 0, sizeof(*r));
+  strncpy(r->text, line, sizeof(r->text) - 1);
+  strncpy(buf, line, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = '\0';
+  for (p = buf; *p; ++p) if (*p == ',') *p = ' ';
+  for (p = strtok(buf, " \t"); p && n < 64; p = strtok(NULL, " \t")) word[n++] = p;
+
+  *error = "trigger should be like A3 On";
+  if (n < 2 || !parseunit(word[0], &r->house, &r->unit, 1)
+      || (f = x10_parse_func(word[1])) < 0) return 0;
+  r->func = f;
+  i = 2;
+
+  if (i < n && strcasecmp(word[i], "while") == 0) {
+    do {
+      *error = "condition should be like A7 Off";
+      if (++i + 1 >= n || r->nconds == MAXCONDS || !parseunit(word[i], &h, &u, 0))
+	return 0;
+      if (strcasecmp(word[i + 1], "on") != 0 && strcasecmp(word[i + 1], "off") != 0)
+	return 0;
+      r->cond[r->nconds].house = h;
+      r->cond[r->nconds].unit = u;
+      r->cond[r->nconds++].on = strcasecmp(word[i + 1], "on") == 0;
+      i += 2;
+    } while (i < n && strcasecmp(word[i], "and") == 0);
+  }
+
+  *error = "missing ->";
+  if (i >= n || strcmp(word[i++], "->") != 0) return 0;
+  while (i < n) {
+    *error = "command should be like B1 On or B1 Dim 5";
+    if (i + 1 >= n || r->nactions == MAXACTIONS || !parseunit(word[i], &h, &u, 0)
+	|| (f = x10_parse_func(word[i + 1])) < 0) return 0;
+    a = &r->action[r->nactions++];
+    a->house = h;
+    a->unit = u;
+    a->func = f;
+    if (i + 2 < n && isdigit((unsigned char) word[i + 2][0])) {
+      a->data = atoi(word[i + 2]) & 0xFF;
+      i += 3;
+    } else {
+      a->data = -1;
+      i += 2;
+    }
+  }
+  *error = "no commands";
+  return r->nactions > 0;
+}
+
+/* reads and compiles a rules file, NULL if it has an error */
+struct ruleset *loadrules(const char *path, const struct ruleset *old)
+{
+  struct ruleset *rs;
+  struct rule *r;
+  FILE *f;
+  char line[LINESIZE], *p;
+  const char *error;
+  unsigned int count[4096 + 1], key;
+  int lineno = 0, i, j, u;
+
+  if ((f = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "Error opening rules %s\n", path);
+    return NULL;
+  }
+  rs = calloc(1, sizeof(*rs));
+  while (rs && fgets(line, sizeof(line), f)) {
+    ++lineno;
+    if ((p = strchr(line, '#')) != NULL) *p = '\0';
+    for (p = line + strlen(line); p > line && isspace((unsigned char) p[-1]); --p);
+    *p = '\0';
+    for (p = line; isspace((unsigned char) *p); ++p);
+    if (*p == '\0') continue;
+    if (rs->nrules == MAXRULES) {
+      fprintf(stderr, "Error in rules %s line %d: over %d rules\n", path, lineno, MAXRULES);
+      free(rs);
+      rs = NULL;
+    } else if (!parserule(&rs->rule[rs->nrules++], p, &error)) {
+      fprintf(stderr, "Error in rules %s line %d: %s\n", path, lineno, error);
+      free(rs);
+      rs = NULL;
+    }
+  }
+  fclose(f);
+  if (rs == NULL) return NULL;
+
+  /* counters carry over to the same rule */
+  for (i = 0; old && i < rs->nrules; ++i)
+    for (j = 0; j < old->nrules; ++j)
+      if (strcmp(rs->rule[i].text, old->rule[j].text) == 0) {
+	r = &rs->rule[i];
+	r->hits = old->rule[j].hits;
+	r->fired = old->rule[j].fired;
+	r->latsum = old->rule[j].latsum;
+	r->latmax = old->rule[j].latmax;
+	break;
+      }
+
+  /* count the rules in each slot, then place them */
+  memset(count, 0, sizeof(count));
+  for (i = 0; i < rs->nrules; ++i)
+    for (u = 0; u < 16; ++u) {
+      r = &rs->rule[i];
+      if (r->unit == ANYUNIT || r->unit == u) count[r->house << 8 | u << 4 | r->func]++;
+    }
+  for (key = 0; key < 4096; ++key) rs->slot[key + 1] = rs->slot[key] + count[key];
+  memcpy(count, rs->slot, sizeof(count));
+  for (i = 0; i < rs->nrules; ++i)
+    for (u = 0; u < 16; ++u) {
+      r = &rs->rule[i];
+      if (r->unit == ANYUNIT || r->unit == u)
+	rs->index[count[r->house << 8 | u << 4 | r->func]++] = i;
+    }
+  return rs;
+}
+
+void printstats(void)
+{
+  const struct rule *r;
+  int i;
+
+  for (i = 0; i < rules->nrules; ++i) {
+    r = &rules->rule[i];
+    fprintf(stderr, "%s: hits %lu, fired %lu", r->text,
+	    (unsigned long) r->hits, (unsigned long) r->fired);
+    if (r->fired)
+      fprintf(stderr, ", mean %.1f us, max %.1f us", r->latsum / 1e3 / r->fired,
+	      r->latmax / 1e3);
+    fprintf(stderr, "\n");
+  }
+}
+
+void printaction(const struct action *a)
+{
+  printf("%c%d %s", 'A' + a->house, a->unit + 1, x10_funcname[a->func]);
+  if (a->data >= 0) printf(" %d", a->data);
+  printf("\n");
+}
+
+/* func heard on the units in mask of house h */
+void runrules(int h, unsigned int mask, int func)
+{
+  struct rule *r;
+  const struct cond *c;
+  unsigned int k, key;
+  uint64_t lat;
+  int u, i;
+
+  ++eventno;
+  for (u = 0; mask; ++u, mask >>= 1) {
+    if (!(mask & 1)) continue;
+    key = h << 8 | u << 4 | func;
+    for (k = rules->slot[key]; k < rules->slot[key + 1]; ++k) {
+      r = &rules->rule[rules->index[k]];
+      if (r->event == eventno) continue;
+      r->event = eventno;
+      r->hits++;
+      for (i = 0, c = r->cond; i < r->nconds; ++i, ++c)
+	if (state.unit[c->house][c->unit].on != c->on) break;
+      if (i < r->nconds) continue;
+      for (i = 0; i < r->nactions; ++i) printaction(&r->action[i]);
+      r->fired++;
+      lat = nanoseconds() - readtime;
+      r->latsum += lat;
+      if (lat > r->latmax) r->latmax = lat;
+      if (debugmode) fprintf(stderr, "fired %s\n", r->text);
+    }
+  }
+}
+
+void applyrecs(const struct x10_rec *rec, int n)
+{
+  int i, h;
+
+  for (i = 0; i < n; ++i) {
+    x10_state_apply(&state, &rec[i], readtime);
+    if (rec[i].type != 'F') continue;
+    h = rec[i].house - 'A';
+    switch (rec[i].value) {
+    case X10_ALL_UNITS_OFF:
+    case X10_ALL_LIGHTS_ON:
+    case X10_ALL_LIGHTS_OFF:
+      runrules(h, 0xFFFF, rec[i].value);
+      break;
+    default:
+      runrules(h, state.addressed[h], rec[i].value);
+      break;
+    }
+  }
+}
+
+void applyupload(struct cm11a_port *p, const struct cm11a_rx *rx)
+{
+  struct x10_rec rec[CM11A_MAXUPLOAD];
+
+  x10_decode_batch(&rx->buf[1], &rx->buf[0], cm11a_upload_len(rx), rec, &datacount);
+  applyrecs(rec, cm11a_upload_len(rx));
+}
+
+/* rawx10 lines, each timed from when it is taken */
+void textupload(struct cm11a_port *p, const struct cm11a_rx *rx)
+{
+  readtime = nanoseconds();
+  applyupload(p, rx);
+}
+
+/* the uploads in what was just read are timed from here */
+void porttraffic(struct cm11a_port *p, const unsigned char *buf, int n, int dir)
+{
+  if (dir == X10CAP_RX) readtime = nanoseconds();
+}
+
+void portevent(struct cm11a_port *p, int what)
+{
+  if (what == CM11A_RX_BADCOUNT)
+    fprintf(stderr, "Unsynchronized error, dumping buffer\n");
+}
+
+int main(int argc, char* argv[ ])
+{
+  static const struct cm11a_hooks porthooks = {porttraffic, applyupload, portevent};
+  static const struct cm11a_hooks texthooks = {NULL, textupload, NULL};
+  struct cm11a_port port;
+  struct ruleset *next;
+  struct sigaction sa;
+  struct pollfd pfd;
+  const char *portname = NULL, *rulesname;
+  int c, n, ready, fd;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "dp:")) != -1)
+    switch (c) {
+    case 'd':
+      debugmode = 1;
+      break;
+    case 'p':
+      portname = optarg;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: x10rules [-d] [-p port] rulesfile\n");
+    exit(-1);
+  }
+  rulesname = argv[optind];
+  if ((rules = loadrules(rulesname, NULL)) == NULL) return 1;
+
+  x10_state_init(&state);
+  if (portname == NULL) fd = 0;
+  else if ((fd = cm11a_open(portname)) < 0) {
+    fprintf(stderr, "Error opening port %s\n", portname);
+    return 1;
+  }
+  cm11a_init(&port, fd, portname ? &porthooks : &texthooks, NULL);
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  /* no SA_RESTART, so the signals get a blocked read() back here */
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sighup;
+  sigaction(SIGHUP, &sa, NULL);
+  sa.sa_handler = sigusr1;
+  sigaction(SIGUSR1, &sa, NULL);
+
+  for(;;) {
+    if (reload) {
+      reload = 0;
+      if ((next = loadrules(rulesname, rules)) != NULL) {
+	free(rules);
+	rules = next;
+	fprintf(stderr, "Loaded %d rules from %s\n", rules->nrules, rulesname);
+      }
+    }
+    if (report) {
+      report = 0;
+      printstats();
+    }
+
+    /* the timeout is for cm11a_tick, it drops an upload that lost a byte */
+    ready = poll(&pfd, 1, cm11a_polltimeout(&port));
+    if (ready <= 0) n = ready;
+    else n = portname ? cm11a_read(&port) : cm11a_read_text(&port);
+    cm11a_tick(&port);
+    if (ready == 0 || (n < 0 && errno == EINTR)) continue;
+    if (n <= 0) {
+      fprintf(stderr, "Error reading %s: %s\n", portname ? portname : "input",
+	      n == 0 ? "end of file" : strerror(errno));
+      break;
+    }
+    fflush(stdout);
+  }
+
+  printstats();
+  return 0;
+}
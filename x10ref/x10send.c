@@ -0,0 +1,224 @@
+/*  x10send.c  sends X-10 commands through a CM11A
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    reads commands, one per line, on standard input, as x10rules prints
+    them:
+        B1 On
+        C8 Dim 5        dim or bright with a step count 0-22
+        A All_Units_Off a function for the whole house
+    and transmits them on the CM11A (see cm11a.h), answering its polls
+    as rawx10 does and printing what it uploads the same way, "A 0x66"
+    a line at a time.  commands for the same house and function are
+    batched to share one function code (see x10sched.h), -b sets how
+    long in ms a command may be passed by later ones to make a batch
+    (500), 0 only batches commands in a row, -v prints each batch.
+    at the end of input it waits for the queue to empty, then prints
+    the commands sent per second, the retries, the powerline time the
+    batching saved and the time from reading a command to the CM11A's
+    0x55 for its last code
+    usage:  x10send [-d] [-v] [-b ms] [-p port]
+    build:  cc -O2 -I../libx10 -o x10send x10send.c ../libx10/cm11a.c ../libx10/x10sched.c ../libx10/x10.c ../libx10/x10cap.c
+*/
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cm11a.h"
+#include "x10cap.h"
+#include "x10sched.h"
+
+#define DEFAULTPORT "/dev/ttyS0"
+#define LINESIZE 128
+#define BUDGET 500	/* ms */
+
+int debugmode = 0, verbose = 0;
+unsigned long commands = 0, badlines = 0;
+
+void printbatch(struct x10sched *s, const struct x10sched_batch *b)
+{
+  int u;
+
+  if (!verbose) return;
+  for (u = 0; u < 16; ++u)
+    if ((b->units >> u) & 1) fprintf(stderr, "%c%d ", x10_house_letter(b->house), u + 1);
+  if (b->units == 0) fprintf(stderr, "%c ", x10_house_letter(b->house));
+  fprintf(stderr, "%s", x10_funcname[b->func]);
+  if (b->dims) fprintf(stderr, " %d", b->dims);
+  fprintf(stderr, ": %d commands, %d codes, %d saved, %.2f s\n", b->commands,
+	  b->frames, b->saved, b->saved * X10SCHED_FRAMEUS / 1e6);
+}
+
+void printupload(struct cm11a_port *p, const struct cm11a_rx *rx)
+{
+  int j;
+
+  /* somebody else's codes may have addressed other units */
+  x10sched_heard(p->ctx);
+  for (j = 0; j < cm11a_upload_len(rx); ++j)
+    printf("%c 0x%02X\n", cm11a_upload_isfunc(rx, j) ? 'F' : 'A',
+	   (int) cm11a_upload_code(rx, j));
+  fflush(stdout);
+}
+
+void portevent(struct cm11a_port *p, int what)
+{
+  if (what == CM11A_RX_BADCOUNT)
+    fprintf(stderr, "Unsynchronized error, dumping buffer\n");
+}
+
+/* "B1 On", "C8 Dim 5" or "A All_Units_Off", returns 0 if it isn't one */
+int parsecommand(const char *line, struct x10_cmd *cmd, int *dims)
+{
+  char where[8], func[32];
+  int n, h, f, u;
+
+  *dims = 0;
+  n = sscanf(line, "%7s %31s %d", where, func, dims);
+  if (n < 2 || (h = x10_parse_house(where[0])) < 0 || (f = x10_parse_func(func)) < 0)
+    return 0;
+  cmd->house = h;
+  cmd->func = f;
+  cmd->unit = X10_NOUNIT;
+  if (where[1] != '\0') {
+    if ((u = x10_parse_unit(atoi(where + 1))) < 0) return 0;
+    cmd->unit = u;
+  }
+  return 1;
+}
+
+char in[4096];
+int inlen = 0;
+
+/* queues the whole lines read while the queue has room, the rest wait
+   in the buffer for it to drain */
+void queuelines(struct x10sched *sched)
+{
+  struct x10_cmd cmd;
+  char *line = in, *eol;
+  int dims;
+
+  while ((eol = memchr(line, '\n', in + inlen - line)) != NULL) {
+    *eol = '\0';
+    if (parsecommand(line, &cmd, &dims)) {
+      if (x10sched_add(sched, &cmd, dims, x10cap_now()) < 0) {
+	*eol = '\n';
+	break;
+      }
+      commands++;
+    } else if (line[0] != '\0') {
+      fprintf(stderr, "Bad command: %s\n", line);
+      badlines++;
+    }
+    line = eol + 1;
+  }
+  inlen -= line - in;
+  memmove(in, line, inlen);
+}
+
+/* reads more commands into the buffer, returns 0 at end of input */
+int readcommands(void)
+{
+  int n;
+
+  /* no newline in a full buffer */
+  if (inlen == sizeof(in)) {
+    fprintf(stderr, "Bad command: line too long\n");
+    badlines++;
+    inlen = 0;
+  }
+  n = read(0, in + inlen, sizeof(in) - inlen);
+  if (n < 0 && errno == EINTR) return 1;
+  if (n <= 0) {
+    /* a last line without its newline */
+    if (inlen > 0) in[inlen++] = '\n';
+    return 0;
+  }
+  inlen += n;
+  return 1;
+}
+
+int main(int argc, char* argv[ ])
+{
+  static const struct cm11a_hooks hooks = {NULL, printupload, portevent};
+  struct cm11a_port port;
+  struct x10sched sched;
+  const struct cm11a_txstats *st = &port.txstats;
+  struct pollfd pfd[2];
+  const char *portname = DEFAULTPORT;
+  uint64_t start, budget = BUDGET * 1000;
+  int c, fd, eof = 0;
+  double secs;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "b:dp:v")) != -1)
+    switch (c) {
+    case 'b':
+      budget = atof(optarg) * 1000;
+      break;
+    case 'd':
+      debugmode = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'p':
+      portname = optarg;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+
+  if ((fd = cm11a_open(portname)) < 0) {
+    fprintf(stderr, "Error opening port %s\n", portname);
+    return 1;
+  }
+  cm11a_init(&port, fd, &hooks, &sched);
+  x10sched_init(&sched, &port, budget);
+  sched.batched = printbatch;
+  start = x10cap_now();
+
+  /* stdin is left alone while the queue is full, lines already read
+     go in first as it drains */
+  while (!eof || inlen > 0 || x10sched_pending(&sched) > 0 ||
+	 cm11a_pending(&port) > 0) {
+    pfd[0].fd = fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = eof || x10sched_pending(&sched) == X10SCHED_MAX ? -1 : 0;
+    pfd[1].events = POLLIN;
+    if (poll(pfd, 2, cm11a_polltimeout(&port)) < 0 && errno != EINTR) break;
+
+    if (pfd[0].revents) {
+      if (cm11a_read(&port) <= 0) {
+	fprintf(stderr, "Error reading port %s\n", portname);
+	break;
+      }
+    }
+    if (pfd[1].revents && !readcommands()) eof = 1;
+    cm11a_tick(&port);
+    queuelines(&sched);
+    x10sched_run(&sched, x10cap_now());
+    if (debugmode)
+      fprintf(stderr, "queue %d, sent %lu\n", cm11a_pending(&port),
+	      (unsigned long) st->sent);
+  }
+
+  secs = (x10cap_now() - start) / 1e6;
+  fprintf(stderr, "%lu commands, %lu codes sent in %.2f s, %.2f commands/s\n",
+	  commands, (unsigned long) st->sent, secs, secs > 0 ? commands / secs : 0);
+  fprintf(stderr, "retries %lu, interrupted by polls %lu, timeouts %lu, "
+	  "failed %lu, bad lines %lu\n",
+	  (unsigned long) st->retries, (unsigned long) st->interrupts,
+	  (unsigned long) st->timeouts, (unsigned long) st->failed, badlines);
+  fprintf(stderr, "%lu batches, %lu codes saved, %.2f s of powerline time\n",
+	  (unsigned long) sched.stats.batches, (unsigned long) sched.stats.saved,
+	  sched.stats.saved * X10SCHED_FRAMEUS / 1e6);
+  if (sched.stats.commands > 0)
+    fprintf(stderr, "read to done: mean %.1f ms, max %.1f ms\n",
+	    sched.stats.latsum / 1e3 / sched.stats.commands, sched.stats.latmax / 1e3);
+  return 0;
+}
@@ -0,0 +1,346 @@
+/*  x10stat.c  traffic statistics of X-10 capture files
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    reads captures made by rawx10 -c, rawmr26 -c or x10merge -o in one
+    pass, memory the same however long they are, and prints
+        CM11A upload sizes, POLL to 0xC3 ack time with the polls that
+        had to be repeated, and ack to the end of the upload
+        MR26A presses: frames per press and the spacing of the repeats
+        inter-arrival of presses (MR26A) and commands (CM11A) of any
+        code, and between the presses of each house, unit and function
+        what each dedupe window would have made of the traffic, for
+        both: presses reported, presses reported more than once (split,
+        a repeat missed for longer than the window) and presses lost
+        in the one before (merged), as rawmr26 -w would have done
+    a press is frames or commands with the same code on the same port,
+    each less than the burst gap after the one before.  a CM11A command
+    to a group of units counts once for each unit.  each file starts
+    over, merge captures with x10merge -o to see them as one
+    usage:  x10stat [-g ms] [-w ms,ms,...] capture ...
+            -g burst gap (500)
+            -w dedupe windows to try (0,50,100,150,200,250,300,400,500,
+               750,1000)
+    build:  cc -O2 -I../libx10 -o x10stat x10stat.c ../libx10/x10.c \
+               ../libx10/x10cap.c ../libx10/x10emu.c -lm
+*/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "x10.h"
+#include "x10cap.h"
+#include "x10emu.h"
+
+#define NUMCODES (16 * 17 * 16)	/* house, unit or 16 for the house, function */
+#define BURSTGAP 500000		/* microseconds */
+#define MAXWINDOWS 16
+#define MAXBURST 32		/* frames per press counted one by one */
+#define NUMPORTS 256		/* by meta, port and protocol */
+#define NOTIME UINT64_MAX
+
+/* one code on one port */
+struct codestate {
+  uint64_t last, start;	/* last frame, first frame of the press */
+  unsigned int frames;
+};
+
+struct portstate {
+  struct codestate *codes;	/* NULL until the port is seen */
+  struct cm11a_rx cm;
+  struct mr26a_rx mr;
+  unsigned char house;
+  unsigned int units;	/* bit per unit code addressed */
+  int newgroup, datacount;
+  uint64_t polltime, acktime;
+  int polls;		/* polls not acked yet */
+};
+
+/* presses of one protocol */
+struct protostat {
+  const char *name, *event;
+  uint64_t events, presses;
+  uint64_t lastpress;	/* start of the last press of any code */
+  uint64_t burstsize[MAXBURST + 1];	/* the last one is MAXBURST or more */
+  struct x10emu_hist spacing, interarrival;
+  uint64_t reported[MAXWINDOWS], split[MAXWINDOWS], merged[MAXWINDOWS];
+};
+
+struct portstate ports[NUMPORTS];
+struct protostat protos[2] = {
+  {.name = "cm11a", .event = "commands", .lastpress = NOTIME},
+  {.name = "mr26a", .event = "frames", .lastpress = NOTIME}};
+struct x10emu_hist codes[NUMCODES];
+uint64_t uploadsize[CM11A_MAXUPLOAD], uploads, polls, pollretries, timereqs;
+struct x10emu_hist pollack, uploadtime;
+uint64_t windows[MAXWINDOWS], burstgap = BURSTGAP;
+int numwindows;
+
+int codekey(int house, int unit, int func)
+{
+  return (house * 17 + (unit == X10_NOUNIT ? 16 : unit)) * 16 + func;
+}
+
+void endpress(struct protostat *ps, const struct codestate *cs)
+{
+  if (cs->frames > 0) ps->burstsize[cs->frames < MAXBURST ? cs->frames : MAXBURST]++;
+}
+
+/* a frame or command with code key on port p at time t */
+void event(struct portstate *p, int proto, int key, uint64_t t)
+{
+  struct protostat *ps = &protos[proto == X10CAP_MR26A];
+  struct codestate *cs = &p->codes[key];
+  uint64_t gap = cs->last == NOTIME ? NOTIME : t - cs->last;
+  int w;
+
+  ps->events++;
+  /* rawmr26 reports a frame when the last one of its code is at least
+     the window back, and moves the window on with every frame */
+  for (w = 0; w < numwindows; ++w) {
+    if (gap >= windows[w]) {
+      ps->reported[w]++;
+      if (gap < burstgap) ps->split[w]++;
+    } else if (gap >= burstgap) ps->merged[w]++;
+  }
+
+  if (gap >= burstgap) {
+    endpress(ps, cs);
+    ps->presses++;
+    if (cs->start != NOTIME) x10emu_record(&codes[key], t - cs->start);
+    if (ps->lastpress != NOTIME) x10emu_record(&ps->interarrival, t - ps->lastpress);
+    ps->lastpress = t;
+    cs->start = t;
+    cs->frames = 1;
+  } else {
+    x10emu_record(&ps->spacing, gap);
+    cs->frames++;
+  }
+  cs->last = t;
+}
+
+/* CM11A codes, addresses collected up to their function */
+void upload(struct portstate *p, uint64_t t)
+{
+  unsigned int code;
+  int j, unit;
+
+  uploads++;
+  uploadsize[cm11a_upload_len(&p->cm)]++;
+  if (p->acktime != NOTIME) {
+    x10emu_record(&uploadtime, t - p->acktime);
+    p->acktime = NOTIME;
+  }
+  for (j = 0; j < cm11a_upload_len(&p->cm); ++j) {
+    code = cm11a_upload_code(&p->cm, j);
+    if (p->datacount > 0) {
+      p->datacount--;
+      continue;
+    }
+    if (!cm11a_upload_isfunc(&p->cm, j)) {
+      if (p->newgroup || p->house != code >> 4) p->units = 0;
+      p->newgroup = 0;
+      p->house = code >> 4;
+      p->units |= 1 << (code & 0x0F);
+      continue;
+    }
+    if (p->units == 0 || p->house != code >> 4)
+      event(p, X10CAP_CM11A, codekey(code >> 4, X10_NOUNIT, code & 0x0F), t);
+    else
+      for (unit = 0; unit < 16; ++unit)
+	if (p->units & (1 << unit))
+	  event(p, X10CAP_CM11A, codekey(code >> 4, unit, code & 0x0F), t);
+    p->newgroup = 1;
+    p->datacount = x10_datacount[code & 0x0F];
+  }
+}
+
+void record(const struct x10cap_rec *rec, uint64_t t)
+{
+  struct portstate *p = &ports[rec->meta & ~1];
+  struct x10_cmd cmd;
+  int k;
+
+  if (p->codes == NULL) {
+    p->codes = malloc(NUMCODES * sizeof(struct codestate));
+    if (p->codes == NULL) {
+      fprintf(stderr, "Error: out of memory\n");
+      exit(1);
+    }
+    for (k = 0; k < NUMCODES; ++k) {
+      p->codes[k].last = p->codes[k].start = NOTIME;
+      p->codes[k].frames = 0;
+    }
+    cm11a_rx_init(&p->cm);
+    mr26a_rx_init(&p->mr);
+    p->units = p->newgroup = p->datacount = p->polls = 0;
+    p->acktime = NOTIME;
+  }
+
+  if (x10cap_proto(rec->meta) == X10CAP_MR26A) {
+    if (x10cap_dir(rec->meta) == X10CAP_RX && mr26a_rx_byte(&p->mr, rec->byte) &&
+	mr26a_decode(p->mr.buf, &cmd) == 0)
+      event(p, X10CAP_MR26A, codekey(cmd.house, cmd.unit, cmd.func), t);
+    return;
+  }
+  if (x10cap_dir(rec->meta) == X10CAP_TX) {
+    if (rec->byte == CM11A_POLLACK && p->polls > 0) {
+      x10emu_record(&pollack, t - p->polltime);
+      pollretries += p->polls - 1;
+      p->polls = 0;
+      p->acktime = t;
+    }
+    return;
+  }
+  switch (cm11a_rx_byte(&p->cm, rec->byte)) {
+  case CM11A_RX_POLL:
+    polls++;
+    if (p->polls++ == 0) p->polltime = t;
+    break;
+  case CM11A_RX_TIMEREQ:
+    timereqs++;
+    break;
+  case CM11A_RX_UPLOAD:
+    upload(p, t);
+    break;
+  }
+}
+
+/* presses still open at the end of a file, and its ports start over */
+void endfile(void)
+{
+  struct portstate *p;
+  int k;
+
+  for (p = ports; p < ports + NUMPORTS; ++p) {
+    if (p->codes == NULL) continue;
+    for (k = 0; k < NUMCODES; ++k)
+      endpress(&protos[(p - ports) & X10CAP_MR26A ? 1 : 0], &p->codes[k]);
+    free(p->codes);
+    p->codes = NULL;
+  }
+  protos[0].lastpress = protos[1].lastpress = NOTIME;
+}
+
+int readcapture(const char *path)
+{
+  struct x10cap_reader r;
+  struct x10cap_rec rec;
+  int err;
+
+  if (x10cap_open(&r, path, 0) < 0) {
+    fprintf(stderr, "Error opening capture %s\n", path);
+    return -1;
+  }
+  posix_fadvise(r.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  while ((err = x10cap_next(&r, &rec)) > 0) record(&rec, rec.t + r.anchor);
+  if (err < 0) fprintf(stderr, "Error: bad block in capture %s\n", path);
+  endfile();
+  x10cap_close_reader(&r);
+  return err;
+}
+
+/* the log2 buckets with anything in them */
+void printbuckets(const struct x10emu_hist *h)
+{
+  int b;
+
+  for (b = 0; b < X10EMU_HIST; ++b)
+    if (h->bucket[b] > 0)
+      printf("  < %10.3f ms %10lu\n", ((uint64_t) 2 << b) / 1e3,
+	     (unsigned long) h->bucket[b]);
+}
+
+void printproto(const struct protostat *ps)
+{
+  int k, w;
+
+  if (ps->events == 0) return;
+  printf("%s: %lu %s, %lu presses\n", ps->name, (unsigned long) ps->events,
+	 ps->event, (unsigned long) ps->presses);
+  printf("%s per press     count\n", ps->event);
+  for (k = 1; k <= MAXBURST; ++k)
+    if (ps->burstsize[k] > 0)
+      printf("  %2d%s %16lu\n", k, k == MAXBURST ? "+" : " ",
+	     (unsigned long) ps->burstsize[k]);
+  x10emu_print_hist(stdout, "spacing in a press", &ps->spacing);
+  printbuckets(&ps->spacing);
+  x10emu_print_hist(stdout, "inter-arrival of presses", &ps->interarrival);
+  printbuckets(&ps->interarrival);
+  printf("dedupe window   presses     split    merged\n");
+  for (w = 0; w < numwindows; ++w)
+    printf("  %7.1f ms %10lu %9lu %9lu\n", windows[w] / 1e3,
+	   (unsigned long) ps->reported[w], (unsigned long) ps->split[w],
+	   (unsigned long) ps->merged[w]);
+}
+
+void printstats(void)
+{
+  char name[32];
+  int h, u, f, k;
+
+  if (uploads > 0 || polls > 0) {
+    printf("cm11a: %lu uploads, %lu polls, %lu repeated, %lu time requests\n",
+	   (unsigned long) uploads, (unsigned long) polls,
+	   (unsigned long) pollretries, (unsigned long) timereqs);
+    printf("upload codes     count\n");
+    for (k = 1; k < CM11A_MAXUPLOAD; ++k)
+      if (uploadsize[k] > 0) printf("  %d %16lu\n", k, (unsigned long) uploadsize[k]);
+    x10emu_print_hist(stdout, "poll to ack", &pollack);
+    printbuckets(&pollack);
+    x10emu_print_hist(stdout, "ack to upload", &uploadtime);
+  }
+  printproto(&protos[0]);
+  printproto(&protos[1]);
+
+  printf("inter-arrival of presses by code\n");
+  for (h = 0; h < 16; ++h)
+    for (u = 0; u <= 16; ++u)
+      for (f = 0; f < 16; ++f) {
+	k = codekey(x10_code[h], u == 16 ? X10_NOUNIT : x10_code[u], f);
+	if (codes[k].count == 0) continue;
+	if (u == 16) snprintf(name, sizeof(name), "  %c %s", 'A' + h, x10_funcname[f]);
+	else snprintf(name, sizeof(name), "  %c%02d %s", 'A' + h, u + 1, x10_funcname[f]);
+	x10emu_print_hist(stdout, name, &codes[k]);
+      }
+}
+
+int main(int argc, char* argv[ ])
+{
+  char *s;
+  int c, k, err = 0;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "g:w:")) != -1)
+    switch (c) {
+    case 'g':
+      burstgap = atof(optarg) * 1000;
+      break;
+    case 'w':
+      for (s = strtok(optarg, ","); s != NULL && numwindows < MAXWINDOWS;
+	   s = strtok(NULL, ","))
+	windows[numwindows++] = atof(s) * 1000;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: x10stat [-g ms] [-w ms,ms,...] capture ...\n");
+    exit(-1);
+  }
+  if (numwindows == 0) {
+    static const int defaults[] = {0, 50, 100, 150, 200, 250, 300, 400, 500, 750, 1000};
+
+    for (k = 0; k < (int) (sizeof(defaults) / sizeof(defaults[0])); ++k)
+      windows[numwindows++] = defaults[k] * 1000;
+  }
+
+  for (k = optind; k < argc; ++k)
+    if (readcapture(argv[k]) < 0) err = 1;
+  printstats();
+  return err;
+}
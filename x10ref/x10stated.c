@@ -0,0 +1,304 @@
+/*  x10stated.c  keeps the state of every X-10 unit and serves it on a
+                 Unix socket
+    (C) 2013 Tech World Inc
+    The code released under Open Source Expat MIT License
+
+    sits on a CM11A (-p port, answering it as rawx10 does), or reads
+    rawx10 output on standard input, and keeps one 16x16 array of
+    on/off, level and last change time updated in place (see x10state.h)
+    clients send one command per line and get lines back:
+        get A3        A03 on 100 1380000000.123456
+        get A         the 16 units of house A, then "."
+        get           all 256 units, then "."
+        sub [A[3]]    "ok", then "* A03 off 100 ..." for every change
+        unsub [A[3]]  "ok"
+    on/off is what the unit was last told, level is its brightness in
+    percent, kept while it is off, and the time (wall clock seconds) is
+    its last change, 0 for never.  a client that doesn't keep up with
+    its changes is dropped
+    usage:  x10stated [-d] [-p port] [-s socket]
+    build:  cc -O2 -I../libx10 -o x10stated x10stated.c ../libx10/cm11a.c ../libx10/x10state.c ../libx10/x10batch.c ../libx10/x10.c \
+               ../libx10/x10cap.c
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "cm11a.h"
+#include "x10state.h"
+
+#define DEFAULTSOCKET "/tmp/x10state"
+#define MAXCLIENTS 32
+#define LINESIZE 128
+#define UNITLINE 40	/* longest unit line */
+
+struct client {
+  int fd;
+  char in[LINESIZE];
+  int inlen;
+  unsigned short sub[16];	/* units subscribed to, bit per unit index */
+};
+
+struct x10_state state;
+struct client clients[MAXCLIENTS];
+int nclients = 0;
+unsigned int datacount = 0;
+int debugmode = 0;
+volatile sig_atomic_t stopping = 0;
+
+void stopdaemon(int sig)
+{
+  stopping = 1;
+}
+
+uint64_t wallclock(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+int unitline(char *out, int h, int u)
+{
+  const struct x10_unitstate *s = &state.unit[h][u];
+
+  return sprintf(out, "%c%02d %s %d %lu.%06lu\n", 'A' + h, u + 1,
+		 s->on ? "on" : "off", s->level,
+		 (unsigned long) (s->changed / 1000000),
+		 (unsigned long) (s->changed % 1000000));
+}
+
+/* closes the client, its slot stays until reapclients so the indexes
+   of the poll in progress hold */
+void dropclient(int i)
+{
+  if (debugmode) fprintf(stderr, "client %d gone\n", clients[i].fd);
+  close(clients[i].fd);
+  clients[i].fd = -1;
+}
+
+void reapclients(void)
+{
+  int i, n = 0;
+
+  for (i = 0; i < nclients; ++i)
+    if (clients[i].fd >= 0) clients[n++] = clients[i];
+  nclients = n;
+}
+
+/* writes all of buf or drops the client, returns 0 if it was dropped */
+int sendclient(int i, const char *buf, int n)
+{
+  if (clients[i].fd < 0) return 0;
+  if (write(clients[i].fd, buf, n) == n) return 1;
+  dropclient(i);
+  return 0;
+}
+
+/* tells subscribers about the units changed since the last time */
+void notify(void)
+{
+  char buf[256 * (UNITLINE + 2)];
+  unsigned int mask;
+  int i, h, u, n;
+
+  for (i = 0; i < nclients; ++i) {
+    n = 0;
+    for (h = 0; h < 16; ++h) {
+      mask = state.dirty[h] & clients[i].sub[h];
+      for (u = 0; mask; ++u, mask >>= 1)
+	if (mask & 1) {
+	  buf[n++] = '*';
+	  buf[n++] = ' ';
+	  n += unitline(buf + n, h, u);
+	}
+    }
+    if (n > 0) sendclient(i, buf, n);
+  }
+  memset(state.dirty, 0, sizeof(state.dirty));
+}
+
+void applyrecs(const struct x10_rec *rec, int n)
+{
+  uint64_t t = wallclock();
+  int i, changed = 0;
+
+  for (i = 0; i < n; ++i) changed += x10_state_apply(&state, &rec[i], t);
+  if (changed) notify();
+}
+
+void applyupload(struct cm11a_port *p, const struct cm11a_rx *rx)
+{
+  struct x10_rec rec[CM11A_MAXUPLOAD];
+
+  x10_decode_batch(&rx->buf[1], &rx->buf[0], cm11a_upload_len(rx), rec, &datacount);
+  applyrecs(rec, cm11a_upload_len(rx));
+}
+
+void portevent(struct cm11a_port *p, int what)
+{
+  if (what == CM11A_RX_BADCOUNT)
+    fprintf(stderr, "Unsynchronized error, dumping buffer\n");
+}
+
+/* "A3", "A" or "" to house and unit indexes, -1 for all, 0 if bad */
+int parseunit(const char *arg, int *h, int *u)
+{
+  *h = *u = -1;
+  while (*arg == ' ') ++arg;
+  if (*arg == '\0') return 1;
+  if (x10_parse_house(*arg) < 0) return 0;
+  *h = (*arg | 0x20) - 'a';
+  if (arg[1] == '\0') return 1;
+  *u = atoi(arg + 1) - 1;
+  return *u >= 0 && *u < 16;
+}
+
+void command(int i, char *line)
+{
+  char buf[256 * UNITLINE + 4];
+  struct client *c = &clients[i];
+  int h, u, hh, n = 0, sub;
+
+  if (strncmp(line, "get", 3) == 0 && parseunit(line + 3, &h, &u)) {
+    if (u >= 0) n = unitline(buf, h, u);
+    else {
+      for (hh = 0; hh < 16; ++hh)
+	if (h < 0 || h == hh)
+	  for (u = 0; u < 16; ++u) n += unitline(buf + n, hh, u);
+      n += sprintf(buf + n, ".\n");
+    }
+  } else if (((sub = strncmp(line, "sub", 3) == 0) && parseunit(line + 3, &h, &u))
+	     || (strncmp(line, "unsub", 5) == 0 && parseunit(line + 5, &h, &u))) {
+    for (hh = 0; hh < 16; ++hh)
+      if (h < 0 || h == hh) {
+	if (sub) c->sub[hh] |= u < 0 ? 0xFFFF : 1 << u;
+	else c->sub[hh] &= u < 0 ? 0 : ~(1 << u);
+      }
+    n = sprintf(buf, "ok\n");
+  } else n = sprintf(buf, "error %s\n", line);
+  sendclient(i, buf, n);
+}
+
+/* returns 0 if the client went away */
+int readclient(int i)
+{
+  struct client *c = &clients[i];
+  char *line, *eol;
+  int n;
+
+  n = read(c->fd, c->in + c->inlen, sizeof(c->in) - c->inlen);
+  if (n <= 0) {
+    dropclient(i);
+    return 0;
+  }
+  c->inlen += n;
+  line = c->in;
+  while ((eol = memchr(line, '\n', c->in + c->inlen - line)) != NULL) {
+    *eol = '\0';
+    if (eol > line && eol[-1] == '\r') eol[-1] = '\0';
+    command(i, line);
+    if (c->fd < 0) return 0;
+    line = eol + 1;
+  }
+  c->inlen -= line - c->in;
+  memmove(c->in, line, c->inlen);
+  if (c->inlen == sizeof(c->in)) {
+    dropclient(i);
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char* argv[ ])
+{
+  static const struct cm11a_hooks hooks = {NULL, applyupload, portevent};
+  struct cm11a_port port;
+  struct sockaddr_un addr;
+  struct pollfd pfd[MAXCLIENTS + 2];
+  const char *portname = NULL, *socketname = DEFAULTSOCKET;
+  int c, i, n, infd, listenfd;
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, "dp:s:")) != -1)
+    switch (c) {
+    case 'd':
+      debugmode = 1;
+      break;
+    case 'p':
+      portname = optarg;
+      break;
+    case 's':
+      socketname = optarg;
+      break;
+    case '?':
+      fprintf(stderr, "Unknown argument: %c\n", optopt);
+      exit(-1);
+    }
+
+  x10_state_init(&state);
+  if (portname == NULL) infd = 0;
+  else if ((infd = cm11a_open(portname)) < 0) {
+    fprintf(stderr, "Error opening port %s\n", portname);
+    return 1;
+  }
+  cm11a_init(&port, infd, &hooks, NULL);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socketname, sizeof(addr.sun_path) - 1);
+  unlink(socketname);
+  listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenfd < 0 || bind(listenfd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+      || listen(listenfd, 8) < 0) {
+    fprintf(stderr, "Error opening socket %s: %s\n", socketname, strerror(errno));
+    return 1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stopdaemon);
+  signal(SIGTERM, stopdaemon);
+
+  while (!stopping) {
+    pfd[0].fd = infd;
+    pfd[1].fd = listenfd;
+    for (i = 0; i < nclients; ++i) pfd[i + 2].fd = clients[i].fd;
+    for (i = 0; i < nclients + 2; ++i) pfd[i].events = POLLIN;
+    if (poll(pfd, nclients + 2, cm11a_polltimeout(&port)) < 0) continue;
+    cm11a_tick(&port);
+
+    if (pfd[0].revents) {
+      n = portname ? cm11a_read(&port) : cm11a_read_text(&port);
+      if (n <= 0) {
+	fprintf(stderr, "Error reading %s: %s\n", portname ? portname : "input",
+		n == 0 ? "end of file" : strerror(errno));
+	break;
+      }
+    }
+    /* the port may have dropped clients already */
+    for (i = 0; i < nclients; ++i)
+      if (pfd[i + 2].revents && clients[i].fd >= 0) readclient(i);
+    reapclients();
+    if (pfd[1].revents && (c = accept(listenfd, NULL, NULL)) >= 0) {
+      if (nclients == MAXCLIENTS) close(c);
+      else {
+	fcntl(c, F_SETFL, O_NONBLOCK);
+	memset(&clients[nclients], 0, sizeof(clients[0]));
+	clients[nclients++].fd = c;
+	if (debugmode) fprintf(stderr, "client %d\n", c);
+      }
+    }
+  }
+
+  unlink(socketname);
+  return 0;
+}
@@ -0,0 +1,538 @@
+// VS4T1 Video/Audio 4-to-1 switching cable controller
+// XVideo VS4T1-to-CM11A or MR26A video switch firmware
+// (C) 2013 Tech World Inc
+// The code released under Open Source Expat MIT License
+// See license-mit-expat.txt for details
+
+// one image for both receivers: xvideo10.c (CM11A) and xvideo26.c (MR26A)
+// merged, with the receiver detected at power up
+// until a receiver has been heard the serial port swaps between 4800bps and
+// 9600bps every second. at 4800 a CM11A POLL (0x5A) or time request (0xA5)
+// means a CM11A, any other byte is the wrong rate and swaps to 9600 at once
+// so an MR26A repeat burst is not missed. at 9600 a whole D5 AA .. AD frame
+// means an MR26A. a CM11A repeats its POLL every second until answered, so
+// its first upload is never lost
+// the decoders share the camera switching in x10event()
+
+// programming (or menu) mode talks to the user via a serial terminal for device configuration
+// it is entered with '?' or "!!!" at either rate before a CM11A is heard, and
+// with '?' between frames on an MR26A, the same as the separate images.
+// F in the menu moves it to 38400bps and X goes back to run mode at the
+// rate it was entered at
+
+// This code is memory tight on the ATTiny2313, if you are building your own hardware,
+// select a chip with more memory and make your life easier.
+
+// for more X-10 reference, see T_H_X10 project currently at
+//   http://webpages.charter.net/mkeryan/t_h_x10/t_h_x10.htm
+// and the CM11A and MR26A protocol specifications at
+//   ftp.x10.com   cm11a_protocol.txt  cm17a_protocol.txt
+
+// Fuses:
+// Brown-out detection disabled BODLEVEL=1111
+// Int RC Osc 8Mhz 65ms  CKSEL=0100
+// Serial program downloading Enabled SPIEN=0
+
+// Clock: 8Mhz
+// Based on ATTiny2313 2048 bytes flash, 128 bytes RAM, 128 bytes EEPROM
+
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include "libx10/x10codes.h"
+
+// this line instructs avrdude to make an EEP file containing this data
+// and to program the chip with the data at burn time
+uint8_t EEMEM eeprom[5]={"140PS"};
+
+// eeprom storage variables
+struct {
+	unsigned char cam;
+	unsigned char maxcam;
+	unsigned char multiplier;
+	unsigned char housecode;
+	unsigned char idlemode;
+} ee;
+
+#define SCAN_OFF 1		// scan_off is any positive value
+#define SCAN_ON 0
+
+#define RX_NONE 0		// still listening for a receiver
+#define RX_CM11A 1
+#define RX_MR26A 2
+
+#define UBRR_4800 103
+#define UBRR_9600 51
+#define UBRR_38400 25	// programming mode, with U2X, 0.2% off at 8Mhz
+
+unsigned char *eeptr=0x0000;  // dummy ptr for offset in eeprom
+unsigned char timer5 = 0;  // run scan process at 1/5th timer speed
+unsigned char cycnt = '0';   // controls camera switching
+unsigned char scan;			// 1=not scanning 0=scanning
+unsigned char inmenu = 0;    // default to operational mode
+unsigned char menucnt = 0;
+unsigned char suppresscodes = 99;
+unsigned char receiver = RX_NONE;
+unsigned char cmtimeout = 0;
+unsigned char wanttime = 0;
+unsigned char fast = 0;		// programming mode at 38400bps
+unsigned char linkubrr;		// and the rate to go back to
+
+// receive state of both decoders, only one of them runs
+unsigned char numbytes = 0;		// CM11A upload count or MR26A frame position
+unsigned char rcvbufmode = 0;	// CM11A upload in progress
+unsigned char bufidx;
+unsigned char buffer[CM11A_MAXUPLOAD];
+unsigned int units = 0;			// CM11A addressed units of our house, bit 0 is unit 1
+unsigned char newgroup = 0;		// the next address starts a new group
+
+void TransmitByte( unsigned char data )
+{
+	while ( !(UCSRA & (1<<UDRE)) );		// Wait for empty transmit buffer
+
+	unsigned char time;
+
+	unsigned char ms = 20;
+	if(fast) ms = 1;		// no delay needed at the programming rate
+
+  while (--ms != 0) {
+	  // this number (100) is dependent on the clock frequency
+	  for (time=0; time <= 100 ; time++);
+	}
+
+  UDR = data; 			    	// Start transmission
+}
+
+// answers key at the rate in use, then switches to ubrr: UBRR_38400 with U2X
+// for programming mode, or back to the receiver rate
+void setrate(unsigned char key, unsigned char ubrr)
+{
+  UCSRA |= (1<<TXC);    // writing 1 clears it
+  TransmitByte(key);
+  while ( !(UCSRA & (1<<TXC)) );    // Wait for the answer to be sent
+  fast = (ubrr==UBRR_38400);
+  UCSRA = fast<<U2X;
+  UBRRL = ubrr;
+}
+
+// position of c in the first n bytes of a flash table, n if it is not there
+unsigned char lookup(PGM_P table, unsigned char n, unsigned char c)
+{
+  unsigned char x;
+
+  for(x=0;x<n;x++){
+    if(pgm_read_byte(table+x)==c) return x;
+  }
+  return n;
+}
+
+// sets the hardware to the current camera and RTS setting
+void sethdw(){
+  if(ee.cam>'4') ee.cam = '1';
+
+  if(ee.cam=='0'){
+    PORTB = 0x00;
+  } else {
+    PORTB = (1<<(ee.cam-'1'));   // shift 1 cam-'1' positions left
+  }
+
+  __asm__ volatile("nop");
+  __asm__ volatile("nop");
+
+  DDRB = 0x0F;
+
+}
+
+void setcam(){
+  sethdw();
+  scan = SCAN_OFF;
+}
+
+void showbanner(){
+	unsigned char x = 0;
+	unsigned char c;
+
+  PGM_P msg = 	PSTR( "\nXVideo Public Domain\n?:Menu\n" \
+                      "\x05" \
+                      "C: Cameras:\x01\nS: Scan Time:\x02sec\nH: House Code:\x03\nI: Idle Mode:\x04\n0: Video Off\n1-4: Select Camera\n");
+
+	while( (c = pgm_read_byte(msg+x)) ){
+    if(c=='\n') TransmitByte('\r');
+    if(c<= '\x05'){
+
+      if(c=='\x01') TransmitByte(ee.maxcam);
+
+      if(c=='\x02'){
+        TransmitByte( (ee.multiplier + 49)>>1);
+      	if(ee.multiplier & 0x01){
+          TransmitByte('0');
+        } else {
+          TransmitByte('5');
+        }
+      }
+
+      if(c=='\x03') TransmitByte(ee.housecode);
+      if(c=='\x04') TransmitByte(ee.idlemode);
+      if(c=='\x05' && inmenu==0) return;
+
+    } else {
+      TransmitByte(c);
+    }
+
+  	x++;
+  }
+
+}
+
+void saveandshowconfig()
+{
+  unsigned char x;
+
+  for(x=0;x<sizeof(ee);x++){
+    eeprom_write_byte(eeptr+x,((char*)&ee)[x]);
+  }
+	showbanner();
+}
+
+void idle()
+{
+	if(ee.idlemode=='S'){
+		scan = SCAN_ON;	// scan on
+	}
+
+	if(ee.idlemode=='P'){
+		ee.cam = '1';	// priority camera 1
+    setcam();   // scan set off
+	}
+}
+
+// an On (on non zero) or Off for unit '1'-'6' of our house code, from either receiver
+// 1-4 on selects that camera, off goes idle if it is the one showing
+// 5 on scans, 5 off turns the video off, 6 on/off steps to the previous/next camera
+void x10event(unsigned char unit, unsigned char on)
+{
+  unsigned char savecam = ee.cam;
+
+  if(on){
+    if(unit<='4') ee.cam = unit;
+    if(unit=='5'){
+      scan = SCAN_ON;
+      ee.cam = '1';
+      sethdw();
+      return;
+    }
+    if(unit=='6'){
+      if(--ee.cam<'1') ee.cam='4';
+    }
+  } else {
+    if(unit=='5') ee.cam = '0';
+    if(unit=='6'){
+      if(++ee.cam>'4') ee.cam='1';
+    }
+  }
+
+  if(savecam!=ee.cam){
+    setcam();       // do the camera switch
+    TCNT1 = 57723;
+  }
+
+  if(!on && unit==ee.cam){
+    idle();
+  }
+}
+
+// handle timer events
+// timer signalling is always on on this device at 1 second interval
+// every five cycles, scan mode processing is performed.
+// until a receiver is heard, each tick swaps the serial rate
+// MR26A codes are tracked and dropped if duplicates. The MR26A sends each code 5 times
+// Each code is stored in suppresscodes and cleared once per second by the timer
+SIGNAL(SIG_OVERFLOW1)
+{
+
+  timer5++;
+
+  if(timer5>=5){
+  // change cameras every 5 seconds
+  if(scan==SCAN_ON){		// scan is zero
+  	// this code performs the scan change for cameras
+  	// ee.multiplier delays in multiples of 5 seconds as set by user
+  	if(cycnt++ >= ee.multiplier){
+  		if(++ee.cam>ee.maxcam){
+  			ee.cam = '1';
+  		}
+  		sethdw();			// turns off scanning
+  		cycnt = '0';
+  	}
+  } else {				// scan > zero
+  	// not scanning
+  	// runs idle mode setting after 1 minute of inactivity
+  	if(++scan>13){			// after one minute inactivity
+  		idle();
+  	}
+  }
+
+  // sends time initialization to the CM11a every five minutes
+  if(++cmtimeout>60){
+    wanttime = 1;
+    cmtimeout = 0;
+  }
+
+  timer5 = 0;
+  }
+
+  if(receiver==RX_NONE && inmenu==0){
+    UBRRL = (UBRRL==UBRR_4800) ? UBRR_9600 : UBRR_4800;
+    numbytes = 0;
+  }
+
+  // 65536-7813 = 57723  1 second
+  TCNT1 = 57723;
+
+  if(suppresscodes!=99){
+    suppresscodes = 99;
+  }
+}
+
+// user input on the serial port in programming mode
+void menukey(unsigned char inchar)
+{
+  if(inchar>='a'){   // upper case the input
+    inchar -= 0x20;
+  }
+
+  if(inchar>='0' && inchar <='4'){
+    // switch camera input
+    ee.cam = inchar;
+    setcam();
+  }
+
+  if(inchar=='C'){
+    // set max cam to 2,3 or 4
+    if(++ee.maxcam>'4') ee.maxcam='2';
+  }
+
+  if(inchar=='H'){
+    // set house code to A-P
+    if(++ee.housecode>'P') ee.housecode = 'A';
+  }
+
+  if(inchar=='S'){
+    // set scan interval to 5-30 seconds
+    if(++ee.multiplier>'5') ee.multiplier='0';
+  }
+
+  if(inchar=='I'){
+    if(ee.idlemode=='S'){
+      ee.idlemode = 'P';
+    } else {
+      if(ee.idlemode=='P'){
+        ee.idlemode = 'N';
+      } else {
+        ee.idlemode = 'S';
+      }
+    }
+  }
+
+  if(inchar=='C' || inchar=='H' || inchar=='S' || inchar=='I' || inchar=='?'){
+    saveandshowconfig();
+  }
+
+  if(inchar=='F'){
+    // fast programming mode, the PC changes to 38400 once it has the F back
+    if(!fast) linkubrr = UBRRL;
+    setrate('F', UBRR_38400);
+  }
+
+  if(inchar=='X'){
+    // exit the menu to run mode
+    setrate('X', fast ? linkubrr : UBRRL);
+    inmenu = 0;
+    menucnt = 0;
+  }
+}
+
+// sets the CM11A time and the house code it monitors
+void cm11atime(void)
+{
+  unsigned char x;
+  PGM_P timeseq = PSTR("\x9b\x00\x00\x00\x00\x00");
+
+  for(x=0;x<6;x++){
+    TransmitByte(pgm_read_byte(timeseq+x));	// send time cmd
+  }
+  TransmitByte(pgm_read_byte(PSTR(X10_CODES)+ee.housecode-'A')<<4);	// bits 4-7 set the house code
+  wanttime = 0;
+}
+
+// CM11A run mode, the firmware is the PC side of the CM11A protocol
+void cm11abyte(unsigned char inchar)
+{
+  unsigned char x, u;
+
+  if(rcvbufmode==0){
+    // not in the middle of a code, so check this byte
+    if(inchar==CM11A_POLL){			// this is a POLL request from the CM11A  'Z'
+      TransmitByte(CM11A_POLLACK);		// send ACK to CM11A
+      rcvbufmode = 1;		// enter receive mode
+      numbytes = 0;			// clear byte count
+      bufidx = 0;
+    }
+
+    if(inchar==CM11A_TIMEREQ){			// this is a TIME request from the CM11A
+      cm11atime();
+    }
+    return;
+  }
+
+  if(numbytes==0){
+    // the numbytes byte has not been received, so this byte is the byte count
+    if(inchar>CM11A_MAXUPLOAD){
+      // >9 is out of bounds, so abort - this is a sanity check
+      rcvbufmode = 0;
+    } else {
+      numbytes = inchar;
+    }
+    return;
+  }
+
+  // process until the buffer has the expected number of bytes
+  buffer[bufidx++] = inchar;
+  if(bufidx<numbytes) return;
+  rcvbufmode = 0;	// stop receive processing
+
+  // byte 0 is the function/address mask, the rest are codes, low bit first
+  for(x=1;x<numbytes;x++){
+    unsigned char bytehi = (buffer[x]>>4);
+    unsigned char bytelo = buffer[x] & 0x0F;
+    // codes for other houses leave ours alone, as they do a lamp module
+    unsigned char ours = lookup(PSTR(X10_CODES), 16, bytehi)==ee.housecode-'A';
+
+    if(buffer[0] & 0x01){
+      // a function for every unit addressed since the last one, "P1 P5 On" acts on both
+      if(ours){
+        if(bytelo==X10_ON || bytelo==X10_OFF){
+          for(u=0;u<6;u++){
+            if(units & (1<<u)) x10event(u+'1', bytelo==X10_ON);
+          }
+        }
+        newgroup = 1;
+      }
+    } else if(ours){
+      // an address, they add up until a function and the first one after it starts over
+      if(newgroup){
+        units = 0;
+        newgroup = 0;
+      }
+      units |= 1<<lookup(PSTR(X10_CODES), 16, bytelo);
+    }
+    buffer[0] = buffer[0] >> 1;
+  }
+  numbytes = 0;
+
+  // the five minute time set waits for the line to be quiet, sent after
+  // a C3 it would run into the upload
+  if(wanttime) cm11atime();
+}
+
+// MR26A run mode, D5 AA hh uu AD frames streamed by the receiver
+void mr26abyte(unsigned char inchar)
+{
+  if( (numbytes==0 && inchar==MR26A_SYNC1) ||
+      (numbytes==1 && inchar==MR26A_SYNC2) ||
+      (numbytes==4 && inchar==MR26A_END) ||
+      numbytes==2 ||
+      numbytes==3
+    ){
+    buffer[numbytes++] = inchar;
+  } else {
+    // unexpected value, discard data and wait for message
+    numbytes = 0;
+  }
+
+  if(numbytes<MR26A_FRAMELEN) return;
+  numbytes = 0;    // flush buffer if processed or not our house code
+  receiver = RX_MR26A;
+
+  // units 9-16 set bit 2 of buffer[2], none of them switch cameras
+  if( lookup(PSTR(MR26A_HOUSES), 16, buffer[2]>>4)==ee.housecode-'A' &&
+      (buffer[2] & 0x0F)==0 ){
+    // skip duplicate codes rapid fired from MR26A
+    // suppresscodes gets reset after 1 second by timer1
+    if(suppresscodes!=buffer[3]){
+      x10event(lookup(PSTR(MR26A_UNITS), 8, buffer[3] & ~MR26A_OFF) + '1',
+               (buffer[3] & MR26A_OFF)==0);
+      suppresscodes = buffer[3];
+    }
+  }
+}
+
+int main( void )
+{
+	unsigned char inchar;			// input byte from serial port
+
+	// load defaults from eeprom into ee ram structure
+  unsigned char x;
+
+  for(x=0;x<sizeof(ee);x++){
+    ((char*)&ee)[x] = eeprom_read_byte(eeptr+x);
+  }
+
+	DDRB = 0x9F;  // set portb PB5-6 inputs, others to outputs
+	DDRD = 0x00;	  // serial I/O on port D
+  sethdw();     // set PORTB
+
+	// config serial port, listening for a CM11A first
+	UBRRH = 0;  // Set baud rate
+	UBRRL = UBRR_4800;
+	UCSRB = (1<<RXEN)|(1<<TXEN);  // Enable receiver and transmitter
+	UCSRC = (3<<UCSZ0);       // Set frame format: 8N1
+
+	// prescaler takes 8mhz down to 7812.5Hz
+  TCCR1B = (1<<CS10) | (1<<CS12);
+
+	scan = SCAN_OFF;
+	idle();  // set scan mode to eeprom setting. default is on, user may change it
+
+	// activate timer
+  TCNT1 = 57723;				// 1 sec
+	TIMSK |= _BV(TOIE1);		// enable timer1 overflow
+
+	sei();          // timer interrupt on
+
+	while (1) {
+
+		// Check for incoming data on serial port
+		if( (UCSRA & (1<<RXC)) ){ ;
+
+			// data found, disable interrupts
+			cli();
+
+			inchar = UDR;
+
+			if(inmenu){
+        menukey(inchar);
+      } else if(receiver!=RX_CM11A && numbytes==0 && (inchar=='?' || inchar=='!')){
+        // '?' or "!!!" enters the menu
+        if(inchar=='?' || ++menucnt>=3){
+          inmenu = 1;
+          showbanner();
+        }
+      } else if(UBRRL==UBRR_4800){
+        if(receiver==RX_NONE){
+          if(inchar==CM11A_POLL || inchar==CM11A_TIMEREQ){
+            receiver = RX_CM11A;
+          } else {
+            // not a CM11A, try 9600 at once
+            UBRRL = UBRR_9600;
+          }
+        }
+        if(receiver==RX_CM11A) cm11abyte(inchar);
+      } else {
+        mr26abyte(inchar);
+      }
+
+			sei();
+		}
+	}
+}
@@ -4,6 +4,9 @@
 // The code released under Open Source Expat MIT License
 // See license-mit-expat.txt for details
 
+// "!!!" at power up enters the menu, F in the menu moves it to 38400bps
+// and X goes back to run mode at 4800bps
+
 // Fuses:
 // Brown-out detection disabled BODLEVEL=1111
 // Int RC Osc 8Mhz 65ms  CKSEL=0100
@@ -16,6 +19,7 @@
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <avr/eeprom.h>
+#include "libx10/x10codes.h"
 
 // this line makes EEP file used by avrdude to program eeprom
 uint8_t EEMEM eepromdefaults[5]={"140PS"};
@@ -32,6 +36,9 @@ struct {
 #define SCAN_OFF 1		// scan_off is any positive value
 #define SCAN_ON 0
 
+#define UBRR_4800 103	// the CM11A rate
+#define UBRR_38400 25	// programming mode, with U2X, 0.2% off at 8Mhz
+
 unsigned char *eeptr=0x0000; 			
 unsigned char cycnt = '0';
 unsigned char cmtimeout = 0;
@@ -40,6 +47,7 @@ unsigned char disablemenu = 0;
 unsigned char inmenu = 0;
 unsigned char menucnt = 0;
 unsigned char wanttime = 0;
+unsigned char fast = 0;		// programming mode at 38400bps
 
 void TransmitByte( unsigned char data )
 {
@@ -48,6 +56,7 @@ void TransmitByte( unsigned char data )
 	unsigned char time;
 	
 	unsigned char ms = 20;
+	if(fast) ms = 1;		// the delay is for the CM11A, the PC doesn't need it
   	while (--ms != 0) {
     	// this number (100) is dependent on the clock frequency
     	for (time=0; time <= 100 ; time++);
@@ -70,6 +79,18 @@ void TransmitString( PGM_P msg)
 
 }
 
+// answers key at the rate in use, then switches to ubrr: UBRR_38400 with U2X
+// for programming mode, or back to UBRR_4800
+void setrate(unsigned char key, unsigned char ubrr)
+{
+	UCSRA |= (1<<TXC);					// writing 1 clears it
+	TransmitByte(key);
+	while ( !(UCSRA & (1<<TXC)) );		// Wait for the answer to be sent
+	fast = (ubrr==UBRR_38400);
+	UCSRA = fast<<U2X;
+	UBRRL = ubrr;
+}
+
 // switch to camera 1-4 or zero=all off
 //void setcam(unsigned char cam, unsigned char scanmode){
 void setcam(){
@@ -85,7 +106,7 @@ void setcam(){
 // takes a house code A-P and returns an X10 house code suitable for transmission to the CM11a
 unsigned char x10housecode()
 {
-	PGM_P hex = PSTR("\x06\x0e\x02\x0A\x01\x09\x05\x0D\x07\x0F\x03\x0B\x00\x08\x04\x0C");
+	PGM_P hex = PSTR(X10_CODES);
 
 	return pgm_read_byte(hex+ee.housecode-'A');
 }
@@ -179,8 +200,10 @@ SIGNAL(SIG_OVERFLOW1)
 int main( void )
 {
 	unsigned char x;
-	unsigned char house = 0xFF;		// the received house code
-	unsigned char dev = 0xFF;		// the last received device number
+	unsigned char u;
+	unsigned char dev;				// a device number of the group
+	unsigned int units = 0;			// the addressed devices of our house, bit per unit code
+	unsigned char newgroup = 0;		// the next address starts a new group
 	unsigned char numbytes;			// the number of bytes in the CM11 buffer during a receive
 	unsigned char buffer[11];		// the CM11 bytes
 	unsigned char bufidx;			// idx to the buffer
@@ -197,7 +220,7 @@ int main( void )
 	// set baud rate and switch to scan mode on startup
 	// Set baud rate 
 	UBRRH = 0;
-	UBRRL = 103;		// 4800 bps
+	UBRRL = UBRR_4800;		// 4800 bps
 	
 	// Enable receiver and transmitter
 	UCSRB = (1<<RXEN)|(1<<TXEN);
@@ -272,6 +295,20 @@ int main( void )
 					saveandshowconfig();
 				}
 
+				if(inchar=='F'){
+					// fast programming mode, the PC changes to 38400 once it has the F back
+					setrate('F', UBRR_38400);
+				}
+
+				if(inchar=='X'){
+					// exit the menu to run mode at 4800
+					setrate('X', UBRR_4800);
+					inmenu = 0;
+					disablemenu = 1;
+					wanttime = 1;
+					TIMSK |= _BV(TOIE1);
+				}
+
 			} else {
 				if(disablemenu==0){
 					if(inchar=='!'){
@@ -289,14 +326,14 @@ int main( void )
 
 				if(rcvbufmode==0){		
 		    		// not in the middle of a code, so check this byte
-					if(inchar==0x5A){			// this is a POLL request from the CM11A  'Z'
-			    		TransmitByte(0xC3);		// send ACK to CM11A
+					if(inchar==CM11A_POLL){			// this is a POLL request from the CM11A  'Z'
+			    		TransmitByte(CM11A_POLLACK);		// send ACK to CM11A
 						rcvbufmode = 1;		// enter receive mode
 						numbytes = 0;			// clear byte count
 						bufidx = 0;
 					} 
 
-				    if(inchar==0xA5 || wanttime){			// this is a TIME request from the CM11A
+				    if(inchar==CM11A_TIMEREQ || wanttime){			// this is a TIME request from the CM11A
 						//sendtime();				// send the time and house code
 						PGM_P timeseq = PSTR("\x9b\x00\x00\x00\x00\x00");
 						TransmitString(timeseq);			// send time cmd
@@ -304,14 +341,14 @@ int main( void )
 						wanttime = 0;
 					}
 
-			    	if(inchar==0x55){			// This is a CM11A ready indicator, do nothing
+			    	if(inchar==CM11A_READY){			// This is a CM11A ready indicator, do nothing
 						// send on/off status commands here
 					}
 				} else {
 					// in the middle of receiving x10 code, continue
 					if(numbytes==0){
 						// the numbytes byte has not been received, so this byte is the byte count 
-						if(inchar>9){	
+						if(inchar>CM11A_MAXUPLOAD){	
 							// >9 is out of bounds, so abort - this is a sanity check
 							rcvbufmode = 0;
 						} else {
@@ -339,34 +376,37 @@ int main( void )
 								if(buffer[0] & 0x01){
 
 									// bit is set, so this is a function
-									// the events are activated here
-									if(house==x10housecode()){
+									// the events are activated here, once for each addressed
+									// unit 1-6 so "P1 P5 On" acts on both
+									for(u=0;u<6;u++){
+										dev = pgm_read_byte(PSTR(X10_CODES)+u);
+										if(bytehi!=x10housecode() || !(units & (1<<dev))) continue;
 										
-										if(bytelo == 0x02){		// 2	X10 ON Command
+										if(bytelo == X10_ON){		// 2	X10 ON Command
 
 											// switch to selected camera
 											// house code must be P and device must be 1-5
-											if(dev==0x06){		// unit 1 ON
+											if(dev==X10_UNIT1){		// unit 1 ON
 												ee.cam = '1';				
 												setcam();	// goto video 1     
 											}
-											if(dev==0x0E){		// unit 2 ON
+											if(dev==X10_UNIT2){		// unit 2 ON
 												ee.cam = '2';
 												setcam();	// goto video 2
 											}
-											if(dev==0x02){		// unit 3 ON
+											if(dev==X10_UNIT3){		// unit 3 ON
 												ee.cam = '3';
 												setcam();	// goto video 3
 											}
-											if(dev==0x0A){		// unit 4 ON
+											if(dev==X10_UNIT4){		// unit 4 ON
 												ee.cam = '4';
 												setcam();	// goto video 4
 											}
 
-											if(dev==0x01){		// unit 5 ON
+											if(dev==X10_UNIT5){		// unit 5 ON
 												scan = SCAN_ON;	// scan mode on
 											}
-											if(dev==0x09){		// unit 6 ON
+											if(dev==X10_UNIT6){		// unit 6 ON
 												if(--ee.cam<'1') ee.cam='4';
 												setcam();	// switch to prev camera
 											}
@@ -375,30 +415,35 @@ int main( void )
 										}
 
 										// unit off commands
-										if(bytelo==0x03){	// 3	OFF
+										if(bytelo==X10_OFF){	// 3	OFF
 											// for 1-4 OFF, compare unit code to current camera and turn off only if they match
-											if( (dev==0x06 && ee.cam=='1') || 
-												(dev==0x0E && ee.cam=='2') || 
-												(dev==0x02 && ee.cam=='3') || 
-												(dev==0x0A && ee.cam=='4') ){
+											if( (dev==X10_UNIT1 && ee.cam=='1') || 
+												(dev==X10_UNIT2 && ee.cam=='2') || 
+												(dev==X10_UNIT3 && ee.cam=='3') || 
+												(dev==X10_UNIT4 && ee.cam=='4') ){
 												idle();
 											}
 											
-											if(dev==0x01){		// unit 5 OFF
+											if(dev==X10_UNIT5){		// unit 5 OFF
 												ee.cam = '0';
 												setcam();	// turns off video
 											}
 											
-											if(dev==0x09){		// unit 6 OFF
+											if(dev==X10_UNIT6){		// unit 6 OFF
 												if(++ee.cam>'4') ee.cam='1';
 												setcam();		// switch to next camera
 											}
 										}
 									}
-								} else {
-									// bit is clear, so this is an address
-									house = bytehi;
-									dev = bytelo;
+									if(bytehi==x10housecode()) newgroup = 1;
+								} else if(bytehi==x10housecode()){
+									// bit is clear, so this is an address of our house, other houses leave ours alone
+									// addresses add up until a function, the first one after it starts over
+									if(newgroup){
+										units = 0;
+										newgroup = 0;
+									}
+									units |= 1<<bytelo;
 								}
 								buffer[0] = buffer[0] >> 1;
 								
@@ -6,6 +6,7 @@
 
 // this code implements a dual mode serial port
 // programming (or menu) mode talks to the user via a serial terminal for device configuration
+// F in the menu moves it to 38400bps and X goes back to run mode at 9600bps
 // run mode acts as slave to a X-10 MR26A controller
 
 // This code is memory tight on the ATTiny2313, if you are building your own hardware, 
@@ -33,6 +34,7 @@
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <avr/eeprom.h>
+#include "libx10/x10codes.h"
 
 // this line instructs avrdude to make an EEP file containing this data
 // and to program the chip with the data at burn time
@@ -52,6 +54,9 @@ struct {
 #define SCAN_OFF 1		// scan_off is any positive value
 #define SCAN_ON 0
 
+#define UBRR_9600 51	// the MR26A rate
+#define UBRR_38400 25	// programming mode, with U2X, 0.2% off at 8Mhz
+
 
 unsigned char *eeptr=0x0000;  // dummy ptr for offset in eeprom
 unsigned char timer5 = 0;  // run scan process at 1/5th timer speed
@@ -60,6 +65,7 @@ unsigned char scan;			// 1=not scanning 0=scanning
 unsigned char inmenu = 0;    // default to operational mode
 unsigned char menucnt = 0;  
 unsigned char suppresscodes = 99;
+unsigned char fast = 0;		// programming mode at 38400bps
 
 // 66 bytes
 void TransmitByte( unsigned char data )
@@ -68,7 +74,8 @@ void TransmitByte( unsigned char data )
 	
 	unsigned char time;
 	
-	unsigned char ms = 20;
+	unsigned char ms = 20;
+	if(fast) ms = 1;		// no delay needed at the programming rate
 	
   while (--ms != 0) {
 	  // this number (100) is dependent on the clock frequency
@@ -79,6 +86,18 @@ void TransmitByte( unsigned char data )
 }
 
 
+// answers key at the rate in use, then switches to ubrr: UBRR_38400 with U2X
+// for programming mode, or back to UBRR_9600
+void setrate(unsigned char key, unsigned char ubrr)
+{
+  UCSRA |= (1<<TXC);    // writing 1 clears it
+  TransmitByte(key);
+  while ( !(UCSRA & (1<<TXC)) );    // Wait for the answer to be sent
+  fast = (ubrr==UBRR_38400);
+  UCSRA = fast<<U2X;
+  UBRRL = ubrr;
+}
+
 // sets the hardware to the current camera and RTS setting
 // 78 bytes
 void sethdw(){
@@ -233,7 +252,7 @@ int main( void )
 
 	// config serial port
 	UBRRH = 0;  // Set baud rate 
-	UBRRL = 51;   // 9600bps;
+	UBRRL = UBRR_9600;   // 9600bps;
 	UCSRB = (1<<RXEN)|(1<<TXEN);  // Enable receiver and transmitter
 	UCSRC = (3<<UCSZ0);       // Set frame format: 8N1
 
@@ -310,6 +329,17 @@ int main( void )
 					saveandshowconfig();
 				}
 
+				if(inchar=='F'){
+					// fast programming mode, the PC changes to 38400 once it has the F back
+					setrate('F', UBRR_38400);
+				}
+
+				if(inchar=='X'){
+					// exit the menu to run mode
+					setrate('X', UBRR_9600);
+					inmenu = 0;
+				}
+
 			} else {
         if(numbytes==0 && inchar=='?'){
           inmenu = 1;
@@ -337,9 +367,9 @@ int main( void )
           // D5AA7040AD
           // D5AA7050AD B6 on
 
-        	if( (numbytes==0 && inchar==0xD5) ||
-              (numbytes==1 && inchar==0xAA) ||
-              (numbytes==4 && inchar==0xAD) ||
+        	if( (numbytes==0 && inchar==MR26A_SYNC1) ||
+              (numbytes==1 && inchar==MR26A_SYNC2) ||
+              (numbytes==4 && inchar==MR26A_END) ||
               numbytes==2 || 
               numbytes==3
             ){
@@ -349,13 +379,13 @@ int main( void )
             numbytes = 0;
           }
 
-          if(numbytes==5){
+          if(numbytes==MR26A_FRAMELEN){
       		  // a full message has been received, process it
       		  unsigned char houseraw = buffer[2] >> 4;
 
            	// house code list A-P
             // optimized
-            PGM_P hexhouse = PSTR("\x06\x07\x04\x05\x08\x09\x0A\x0B\x0E\x0F\x0C\x0D\x00\x01\x02\x03");
+            PGM_P hexhouse = PSTR(MR26A_HOUSES);
             
             unsigned char x;
             unsigned char hc = 'A';
@@ -386,16 +416,16 @@ int main( void )
         				// device must be 1-5
                 
                 // 14 bytes per line
-                if(unitraw==0x00)  ee.cam = '1';  // 1 on				
-                if(unitraw==0x10)  ee.cam = '2';  // 2 on				
-                if(unitraw==0x08)  ee.cam = '3';  // 3 on				
-                if(unitraw==0x18)  ee.cam = '4';  // 4 on				
-                if(unitraw==0x60)  ee.cam = '0';  // 5 off, video off
-                if(unitraw==0x50) {
+                if(unitraw==MR26A_UNIT1_ON)  ee.cam = '1';  // 1 on				
+                if(unitraw==MR26A_UNIT2_ON)  ee.cam = '2';  // 2 on				
+                if(unitraw==MR26A_UNIT3_ON)  ee.cam = '3';  // 3 on				
+                if(unitraw==MR26A_UNIT4_ON)  ee.cam = '4';  // 4 on				
+                if(unitraw==(MR26A_UNIT5_ON|MR26A_OFF))  ee.cam = '0';  // 5 off, video off
+                if(unitraw==MR26A_UNIT6_ON) {
     							if(--ee.cam<'1') ee.cam='4';  // 6 on, switch to prev camera
                 }
 
-                if(unitraw==0x70) {
+                if(unitraw==(MR26A_UNIT6_ON|MR26A_OFF)) {
           				if(++ee.cam>'4') ee.cam='1';  // 6 off, switch to next camera
                 }
  
@@ -405,17 +435,17 @@ int main( void )
                 }
 
                 // 66 bytes
-                if(unitraw==0x40){
+                if(unitraw==MR26A_UNIT5_ON){
                   scan = SCAN_ON;	// 5 on scan mode on
                   ee.cam = '1';
                   sethdw();
                 }
 
                 // optimized
-                if( (unitraw==0x20 && ee.cam=='1') ||
-                  (unitraw==0x30 && ee.cam=='2') ||
-                  (unitraw==0x28 && ee.cam=='3') ||
-                  (unitraw==0x38 && ee.cam=='4') ){
+                if( (unitraw==(MR26A_UNIT1_ON|MR26A_OFF) && ee.cam=='1') ||
+                  (unitraw==(MR26A_UNIT2_ON|MR26A_OFF) && ee.cam=='2') ||
+                  (unitraw==(MR26A_UNIT3_ON|MR26A_OFF) && ee.cam=='3') ||
+                  (unitraw==(MR26A_UNIT4_ON|MR26A_OFF) && ee.cam=='4') ){
                   idle();
                 }
                 